@@ -0,0 +1,287 @@
+#include "CameraSource.h"
+#include "FramePool.h"
+#include "ScanTrace.h"
+#include "Metrics.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtNetwork>
+#include <algorithm>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+namespace {
+const int kMaxCachedJpegs = 32; // Pliki testowe / plansze - kilka na kamerę wystarczy
+const int kLatencyWindow = 50;
+const int kMinLatencySamples = 10;
+const int kMinHedgeDelayMs = 100;   // Poniżej tego drugie żądanie tylko dokłada ruchu
+const double kMaxHedgeBudget = 2.0; // Po okresie ciszy najwyżej 2 hedge pod rząd
+
+QByteArray encodeJpeg(const cv::Mat &image, int quality) {
+    std::vector<uchar> buf;
+    if (!cv::imencode(".jpg", image, buf, { cv::IMWRITE_JPEG_QUALITY, quality })) return QByteArray();
+    return QByteArray(reinterpret_cast<const char*>(buf.data()), qsizetype(buf.size()));
+}
+}
+
+// =========================================================
+// HTTP SNAPSHOT
+// =========================================================
+struct HttpSnapshotSource::Attempt {
+    CaptureItemPtr item;
+    Done done;
+    QNetworkReply *primary = nullptr;
+    QNetworkReply *hedge = nullptr;
+    QElapsedTimer primaryTimer;
+    int outstanding = 0;
+    bool finished = false;
+};
+
+void HttpSnapshotSource::CameraLatency::add(int ms) {
+    if (samples.size() < kLatencyWindow) {
+        samples.append(ms);
+    } else {
+        samples[next] = ms;
+        next = (next + 1) % kLatencyWindow;
+    }
+}
+
+int HttpSnapshotSource::CameraLatency::p90() const {
+    if (samples.size() < kMinLatencySamples) return -1;
+    QList<int> sorted = samples;
+    const int k = int(sorted.size() - 1) * 9 / 10;
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+HttpSnapshotSource::HttpSnapshotSource(QNetworkAccessManager *netMan, int timeoutMs)
+    : m_netMan(netMan), m_timeoutMs(timeoutMs) {}
+
+void HttpSnapshotSource::fetch(const CaptureItemPtr &item, const Done &done) {
+    auto attempt = std::make_shared<Attempt>();
+    attempt->item = item;
+    attempt->done = done;
+    attempt->primary = startRequest(item, attempt, false);
+
+    if (item->req.hedgePercent <= 0) return;
+
+    // Budżet rośnie z każdym żądaniem - hedging to najwyżej hedgePercent% ruchu do kamery
+    const int camIndex = item->req.camIndex;
+    CameraLatency &cam = m_latency[camIndex];
+    cam.budget = qMin(kMaxHedgeBudget, cam.budget + item->req.hedgePercent / 100.0);
+    const int p90 = cam.p90();
+    if (p90 < 0) return; // Jeszcze się uczymy
+
+    QTimer::singleShot(qMax(kMinHedgeDelayMs, p90), m_netMan, [this, attempt, camIndex]() {
+        if (attempt->finished) return;
+
+        CameraLatency &cam = m_latency[camIndex];
+        if (cam.hedgeInFlight || cam.budget < 1.0) {
+            Metrics::add("capture_hedges_skipped_total", 1);
+            return;
+        }
+        cam.budget -= 1.0;
+        cam.hedgeInFlight = true;
+        Metrics::add("capture_hedges_total", 1);
+        attempt->hedge = startRequest(attempt->item, attempt, true);
+    });
+}
+
+QNetworkReply *HttpSnapshotSource::startRequest(const CaptureItemPtr &item, const std::shared_ptr<Attempt> &attempt, bool hedge) {
+    QNetworkRequest request(item->req.url);
+
+    QString concatenated = item->req.user + ":" + item->req.pass;
+    QByteArray data = concatenated.toLocal8Bit().toBase64();
+    request.setRawHeader("Authorization", "Basic " + data);
+    request.setTransferTimeout(m_timeoutMs);
+
+    if (!hedge) attempt->primaryTimer.start();
+    attempt->outstanding++;
+
+    QNetworkReply *reply = m_netMan->get(request);
+    QObject::connect(reply, &QNetworkReply::finished, m_netMan, [this, attempt, reply, hedge]() {
+        onReply(attempt, reply, hedge);
+    });
+    return reply;
+}
+
+void HttpSnapshotSource::onReply(const std::shared_ptr<Attempt> &attempt, QNetworkReply *reply, bool hedge) {
+    attempt->outstanding--;
+    (hedge ? attempt->hedge : attempt->primary) = nullptr;
+
+    CameraLatency &cam = m_latency[attempt->item->req.camIndex];
+    if (hedge) cam.hedgeInFlight = false;
+
+    // Próbka p90 tylko z żądania głównego: odpowiedź albo czas do przerwania, gdy wygrał
+    // hedge (dolna granica). Hedge startuje dopiero w p90 - jego własny, krótki czas
+    // ściągałby p90 w dół i napędzał kolejne hedge.
+    const bool ok = reply->error() == QNetworkReply::NoError;
+    if (!hedge && (ok || attempt->finished)) cam.add(int(attempt->primaryTimer.elapsed()));
+
+    if (!attempt->finished) {
+        if (ok) {
+            attempt->finished = true;
+            attempt->item->payload = reply->readAll();
+            if (hedge) Metrics::add("capture_hedge_wins_total", 1);
+
+            // Przegrany niepotrzebny - abort() od razu zwalnia połączenie z kamerą
+            QNetworkReply *loser = hedge ? attempt->primary : attempt->hedge;
+            if (loser) loser->abort();
+            attempt->done(attempt->item, QString());
+        } else if (attempt->outstanding == 0) {
+            attempt->finished = true;
+            attempt->done(attempt->item, "HTTP Error: " + reply->errorString());
+        }
+    }
+    reply->deleteLater();
+}
+
+// =========================================================
+// RTSP
+// =========================================================
+RtspSource::RtspSource(QThreadPool *ioPool, QObject *context)
+    : m_ioPool(ioPool), m_context(context) {}
+
+void RtspSource::fetch(const CaptureItemPtr &item, const Done &done) {
+    QObject *context = m_context;
+    m_ioPool->start([context, item, done]() {
+        QString errorMsg;
+        item->frame = FramePool::forCamera(item->req.camIndex).acquire();
+
+        cv::VideoCapture cap;
+        cap.open(item->req.url.toStdString(), cv::CAP_FFMPEG);
+        if (cap.isOpened()) {
+            bool success = false;
+            for(int k=0; k<20; k++) {
+                if(cap.read(item->frame) && !item->frame.empty()) {
+                    success = true;
+                    break;
+                }
+            }
+            if(!success) errorMsg = "RTSP Decode Failed";
+            cap.release();
+        } else {
+            errorMsg = "RTSP Connection Failed";
+        }
+
+        QMetaObject::invokeMethod(context, [item, done, errorMsg]() {
+            done(item, errorMsg);
+        }, Qt::QueuedConnection);
+    });
+}
+
+// =========================================================
+// CACHED JPEG SOURCE (plik / generator)
+// =========================================================
+CachedJpegSource::CachedJpegSource(QThreadPool *ioPool, QObject *context)
+    : m_ioPool(ioPool), m_context(context) {}
+
+void CachedJpegSource::fetch(const CaptureItemPtr &item, const Done &done) {
+    const QString key = cacheKey(item->req);
+
+    auto cached = m_cache.constFind(key);
+    if (cached != m_cache.constEnd()) {
+        // QByteArray współdzielony - każde zdjęcie dostaje te same bajty bez kopii.
+        // done() z kolejki, żeby nie wchodzić rekurencyjnie w pump() potoku.
+        item->payload = *cached;
+        item->cachedJpeg = true;
+        QMetaObject::invokeMethod(m_context, [item, done]() {
+            done(item, QString());
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // Kilka kamer / palet naraz na ten sam plik - jedno przygotowanie
+    QList<std::pair<CaptureItemPtr, Done>> &waiting = m_waiting[key];
+    waiting.append({ item, done });
+    if (waiting.size() > 1) return;
+
+    const CaptureRequest req = item->req;
+    m_ioPool->start([this, key, req]() {
+        const QByteArray jpeg = produce(req);
+        QMetaObject::invokeMethod(m_context, [this, key, jpeg]() {
+            deliver(key, jpeg);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void CachedJpegSource::deliver(const QString &key, const QByteArray &jpeg) {
+    if (!jpeg.isEmpty()) {
+        if (m_cache.size() >= kMaxCachedJpegs) m_cache.clear();
+        m_cache.insert(key, jpeg);
+    }
+
+    const QList<std::pair<CaptureItemPtr, Done>> waiting = m_waiting.take(key);
+    for (const auto &entry : waiting) {
+        if (jpeg.isEmpty()) {
+            entry.second(entry.first, errorText());
+            continue;
+        }
+        entry.first->payload = jpeg;
+        entry.first->cachedJpeg = true;
+        entry.second(entry.first, QString());
+    }
+}
+
+QString FileSource::cacheKey(const CaptureRequest &req) const {
+    // Podmiana pliku na dysku = nowy klucz (stat zamiast czytania przy każdym skanie)
+    const QFileInfo info(req.url);
+    return req.url + "|" + QString::number(info.lastModified().toMSecsSinceEpoch());
+}
+
+QByteArray FileSource::produce(const CaptureRequest &req) const {
+    QFile file(req.url);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    QByteArray data = file.readAll();
+
+    // JPEG idzie dalej bez zmian, inne formaty (PNG) kodujemy raz
+    if (data.startsWith("\xFF\xD8")) return data;
+
+    const cv::Mat raw(1, int(data.size()), CV_8UC1, data.data());
+    const cv::Mat image = cv::imdecode(raw, cv::IMREAD_COLOR);
+    if (image.empty()) return QByteArray();
+    return encodeJpeg(image, 90);
+}
+
+QString SyntheticSource::cacheKey(const CaptureRequest &req) const {
+    return QString("synthetic_%1").arg(req.camIndex);
+}
+
+QByteArray SyntheticSource::produce(const CaptureRequest &req) const {
+    // Plansza 1080p: pasy + numer kamery - widać od razu, która kamera jest syntetyczna
+    cv::Mat image(1080, 1920, CV_8UC3);
+    for (int y = 0; y < image.rows; y += 60) {
+        const cv::Scalar color(40 + (y * 7) % 160, 60 + req.camIndex * 35, 120 + (y / 60) % 2 * 60);
+        cv::rectangle(image, cv::Rect(0, y, image.cols, 60), color, cv::FILLED);
+    }
+    const std::string label = "KAMERA " + std::to_string(req.camIndex + 1) + " (SYNTETYCZNA)";
+    cv::putText(image, label, cv::Point(120, 560), cv::FONT_HERSHEY_SIMPLEX, 3.0,
+                cv::Scalar(255, 255, 255), 6, cv::LINE_AA);
+    return encodeJpeg(image, 85);
+}
+
+// =========================================================
+// REPLAY
+// =========================================================
+ReplaySource::ReplaySource(std::shared_ptr<ReplayCameraLayer> layer, QObject *context)
+    : m_layer(std::move(layer)), m_context(context) {}
+
+void ReplaySource::fetch(const CaptureItemPtr &item, const Done &done) {
+    ScanTrace::CameraResponse r;
+    if (!m_layer->next(item->req.camIndex, r)) {
+        QMetaObject::invokeMethod(m_context, [item, done]() {
+            done(item, "No trace data");
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // Nagrane opóźnienie (przeskalowane) na timerze - jak asynchroniczne HTTP, bez wątku
+    std::shared_ptr<ReplayCameraLayer> layer = m_layer;
+    QTimer::singleShot(layer->scaledDelay(r.latencyMs), m_context, [layer, item, done, r]() {
+        if (r.error.isEmpty()) item->payload = layer->payloadFor(r.width, r.height);
+        done(item, r.error);
+    });
+}
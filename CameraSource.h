@@ -0,0 +1,158 @@
+#ifndef CAMERASOURCE_H
+#define CAMERASOURCE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QRectF>
+#include <QString>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <opencv2/core.hpp>
+#include "ImageEncoder.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QThreadPool;
+class ReplayCameraLayer;
+
+struct CaptureRequest {
+    int camIndex;
+    QString url;    // HTTP/RTSP: adres kamery, plik: ścieżka do zdjęcia
+    int source;     // CameraSource::Kind
+    int rotation;
+    QRectF roi;     // Ułamki obrazu po obrocie, pusty = cała klatka
+    QString user;
+    QString pass;
+    QString savePath;   // Plik w tmp/ (także zapas, gdy spool jest pełny)
+    QString palletCode;
+    bool spool = false; // Zapis do ImageSpool zamiast pliku
+    int hedgePercent = 0; // HTTP: budżet dodatkowych żądań (% żądań kamery), 0 = bez hedgingu
+    ImageEncoder::Settings encoder; // Już po effective() - rozszerzenie savePath mu odpowiada
+    quint64 scanId = 0;   // Skan spekulatywny (kod palety jeszcze nieznany), 0 = zwykły skan
+};
+
+// Stan jednego zdjęcia w potoku - współdzielony przez etapy
+struct CaptureItem {
+    CaptureRequest req;
+    qint64 reserved = 0;
+    bool network = false;    // Pobranie zajmuje sieć (liczone do aktywności przechwytywania)
+    bool cachedJpeg = false; // payload z pamięci źródła lokalnego - bez obrotu i ROI zapis 1:1
+    QByteArray payload;      // Skompresowana klatka (przed dekodowaniem)
+    cv::Mat frame;           // Po dekodowaniu (RTSP: prosto z FFmpeg)
+    cv::Mat rotated;
+    QElapsedTimer fetchTimer;
+    int fetchMs = 0;
+    QString location;        // Gdzie trafił wynik: ścieżka pliku albo "spool:..."
+};
+using CaptureItemPtr = std::shared_ptr<CaptureItem>;
+
+// --- ŹRÓDŁO KAMERY (skąd potok bierze klatkę) ---
+// fetch() i done() zawsze na wątku potoku. Źródło wypełnia item->payload (JPEG)
+// albo item->frame (surowa klatka) i woła done() z pustym błędem przy sukcesie.
+class CameraSource {
+public:
+    enum Kind { Http = 0, Rtsp = 1, File = 2, Synthetic = 3, KindCount };
+    using Done = std::function<void(const CaptureItemPtr &item, const QString &errorMsg)>;
+
+    virtual ~CameraSource() = default;
+    virtual void fetch(const CaptureItemPtr &item, const Done &done) = 0;
+    virtual bool usesNetwork() const { return true; }
+};
+
+// --- HTTP SNAPSHOT (asynchroniczny QNAM na wątku potoku) ---
+// Hedging: gdy kamera nie odpowie w swoim p90, idzie drugie żądanie i wygrywa szybsze.
+// Dodatkowe żądania ogranicza budżet per kamera (procent żądań) i max. jedno naraz.
+class HttpSnapshotSource : public CameraSource {
+public:
+    HttpSnapshotSource(QNetworkAccessManager *netMan, int timeoutMs);
+    void fetch(const CaptureItemPtr &item, const Done &done) override;
+
+private:
+    struct CameraLatency {
+        QList<int> samples;   // Ostatnie czasy odpowiedzi [ms], pierścień
+        int next = 0;
+        double budget = 0;    // Dostępne dodatkowe żądania
+        bool hedgeInFlight = false;
+
+        void add(int ms);
+        int p90() const;      // -1 = za mało próbek
+    };
+    struct Attempt;
+
+    QNetworkReply *startRequest(const CaptureItemPtr &item, const std::shared_ptr<Attempt> &attempt, bool hedge);
+    void onReply(const std::shared_ptr<Attempt> &attempt, QNetworkReply *reply, bool hedge);
+
+    QNetworkAccessManager *m_netMan;
+    int m_timeoutMs;
+    QHash<int, CameraLatency> m_latency;
+};
+
+// --- RTSP (OpenCV/FFmpeg blokuje - pula I/O) ---
+class RtspSource : public CameraSource {
+public:
+    RtspSource(QThreadPool *ioPool, QObject *context);
+    void fetch(const CaptureItemPtr &item, const Done &done) override;
+
+private:
+    QThreadPool *m_ioPool;
+    QObject *m_context;
+};
+
+// --- ŹRÓDŁO LOKALNE Z PAMIĘCIĄ (plik / generator) ---
+// JPEG przygotowany raz na puli I/O, potem podawany z pamięci bez kopii i bez sieci.
+class CachedJpegSource : public CameraSource {
+public:
+    CachedJpegSource(QThreadPool *ioPool, QObject *context);
+    void fetch(const CaptureItemPtr &item, const Done &done) override;
+    bool usesNetwork() const override { return false; }
+
+protected:
+    virtual QString cacheKey(const CaptureRequest &req) const = 0;
+    virtual QByteArray produce(const CaptureRequest &req) const = 0; // Na puli I/O, pusty = błąd
+    virtual QString errorText() const = 0;
+
+private:
+    void deliver(const QString &key, const QByteArray &jpeg);
+
+    QThreadPool *m_ioPool;
+    QObject *m_context;
+    QHash<QString, QByteArray> m_cache;
+    QHash<QString, QList<std::pair<CaptureItemPtr, Done>>> m_waiting; // Czekający na ten sam klucz
+};
+
+class FileSource : public CachedJpegSource {
+public:
+    using CachedJpegSource::CachedJpegSource;
+
+protected:
+    QString cacheKey(const CaptureRequest &req) const override;
+    QByteArray produce(const CaptureRequest &req) const override;
+    QString errorText() const override { return "Source file invalid"; }
+};
+
+class SyntheticSource : public CachedJpegSource {
+public:
+    using CachedJpegSource::CachedJpegSource;
+
+protected:
+    QString cacheKey(const CaptureRequest &req) const override;
+    QByteArray produce(const CaptureRequest &req) const override;
+    QString errorText() const override { return "Synthetic frame failed"; }
+};
+
+// --- ODTWARZANIE ŚLADU (nagrane opóźnienia i błędy zamiast kamer) ---
+class ReplaySource : public CameraSource {
+public:
+    ReplaySource(std::shared_ptr<ReplayCameraLayer> layer, QObject *context);
+    void fetch(const CaptureItemPtr &item, const Done &done) override;
+
+private:
+    std::shared_ptr<ReplayCameraLayer> m_layer;
+    QObject *m_context;
+};
+
+#endif
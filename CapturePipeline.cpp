@@ -0,0 +1,286 @@
+#include "CapturePipeline.h"
+#include "FramePool.h"
+#include "ScanTrace.h"
+#include "JpegTransform.h"
+#include "Metrics.h"
+#include "ImageSpool.h"
+#include "ImageEncoder.h"
+#include <QFile>
+#include <QSet>
+#include <QThread>
+#include <QDebug>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+const int kMaxFetches = 10;        // Równoległe pobrania (2 palety x 5 kamer)
+const int kHttpTimeoutMs = 5000;
+
+int physicalCoreCount() {
+#ifdef Q_OS_LINUX
+    // Qt podaje tylko rdzenie logiczne - HT nie pomaga przy dekodowaniu/kodowaniu JPEG
+    QFile f("/proc/cpuinfo");
+    if (f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QSet<QString> cores;
+        QString physicalId;
+        const QList<QByteArray> lines = f.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            const QString value = QString::fromLatin1(line.mid(line.indexOf(':') + 1)).trimmed();
+            if (line.startsWith("physical id")) physicalId = value;
+            else if (line.startsWith("core id")) cores.insert(physicalId + ":" + value);
+        }
+        if (!cores.isEmpty()) return cores.size();
+    }
+#endif
+    return QThread::idealThreadCount();
+}
+}
+
+// =========================================================
+// CAPTURE PIPELINE
+// =========================================================
+CapturePipeline::CapturePipeline(QObject *parent)
+    : QObject(parent), m_fetching(0), m_netFetching(0), m_cpuBusy(0), m_active(false)
+{
+    m_netMan = new QNetworkAccessManager(this);
+
+    // Osobne pule - nie dzielimy wątków z QtConcurrent ani z globalInstance()
+    m_ioPool = new QThreadPool(this);
+    m_ioPool->setMaxThreadCount(kMaxFetches);
+    m_ioPool->setObjectName("CaptureIO");
+
+    m_cpuPool = new QThreadPool(this);
+    m_cpuPool->setMaxThreadCount(qMax(1, physicalCoreCount()));
+    m_cpuPool->setObjectName("CaptureCPU");
+
+    m_sources[CameraSource::Http].reset(new HttpSnapshotSource(m_netMan, kHttpTimeoutMs));
+    m_sources[CameraSource::Rtsp].reset(new RtspSource(m_ioPool, this));
+    m_sources[CameraSource::File].reset(new FileSource(m_ioPool, this));
+    m_sources[CameraSource::Synthetic].reset(new SyntheticSource(m_ioPool, this));
+
+    // Jedna klatka w obróbce na wątek + jedna czekająca w kolejce puli
+    m_cpuCapacity = 2 * m_cpuPool->maxThreadCount();
+    qDebug() << "CapturePipeline: CPU threads" << m_cpuPool->maxThreadCount()
+             << "CPU queue" << m_cpuCapacity << "fetch slots" << kMaxFetches;
+}
+
+CapturePipeline::~CapturePipeline() {
+    m_ioPool->waitForDone();
+    m_cpuPool->waitForDone();
+}
+
+void CapturePipeline::setReplayLayer(std::shared_ptr<ReplayCameraLayer> layer) {
+    m_replaySource.reset(layer ? new ReplaySource(std::move(layer), this) : nullptr);
+}
+
+CameraSource *CapturePipeline::sourceFor(const CaptureRequest &req) const {
+    if (m_replaySource) return m_replaySource.get();
+    if (req.source < 0 || req.source >= CameraSource::KindCount) return m_sources[CameraSource::Http].get();
+    return m_sources[req.source].get();
+}
+
+void CapturePipeline::submit(const CaptureRequest &req) {
+    m_pending.enqueue(req);
+    pump();
+}
+
+void CapturePipeline::pump() {
+    // Etap 2: pobrane klatki do puli CPU, o ile kolejka CPU ma miejsce
+    while (!m_fetched.isEmpty() && m_cpuBusy < m_cpuCapacity) {
+        ItemPtr item = m_fetched.dequeue();
+        m_fetching--;
+        m_cpuBusy++;
+        m_cpuPool->start([this, item]() { runDecode(item); });
+    }
+
+    // Etap 1: nowe pobrania - ograniczone slotami i budżetem pamięci (backpressure)
+    while (!m_pending.isEmpty() && m_fetching < kMaxFetches) {
+        const CaptureRequest &next = m_pending.head();
+        const qint64 reserved = FramePool::forCamera(next.camIndex).expectedCaptureBytes();
+        if (!MemoryBudget::global().tryAcquire(reserved)) break; // Wrócimy po zwolnieniu pamięci
+
+        ItemPtr item = std::make_shared<CaptureItem>();
+        item->req = m_pending.dequeue();
+        item->reserved = reserved;
+        item->fetchTimer.start();
+        m_fetching++;
+
+        CameraSource *source = sourceFor(item->req);
+        item->network = source->usesNetwork();
+        if (item->network) m_netFetching++;
+        source->fetch(item, [this](const ItemPtr &fetched, const QString &errorMsg) {
+            onFetched(fetched, errorMsg);
+        });
+    }
+
+    updateActivity();
+}
+
+void CapturePipeline::updateActivity() {
+    // Seria = od pierwszego pobrania do ostatniej odpowiedzi kamery (CPU i źródła lokalne nie zajmują sieci)
+    const bool active = !m_pending.isEmpty() || m_netFetching > 0;
+    if (active == m_active) return;
+    m_active = active;
+    if (active) Metrics::add("capture_bursts_total", 1);
+    emit captureActivityChanged(active);
+}
+
+void CapturePipeline::onFetched(const ItemPtr &item, const QString &errorMsg) {
+    item->fetchMs = int(item->fetchTimer.elapsed());
+    if (item->network) m_netFetching--;
+
+    if (!errorMsg.isEmpty()) {
+        if (item->network) {
+            ScanTrace::CameraResponse r;
+            r.camIndex = item->req.camIndex;
+            r.latencyMs = item->fetchMs;
+            r.error = errorMsg;
+            ScanTraceRecorder::instance().recordCamera(r);
+        }
+
+        MemoryBudget::global().release(item->reserved);
+        FramePool::forCamera(item->req.camIndex).release(item->frame);
+        m_fetching--;
+        emit resultReady(item->req.camIndex, false, item->req.savePath, errorMsg, item->req.scanId);
+    } else {
+        m_fetched.enqueue(item);
+    }
+    pump();
+}
+
+bool CapturePipeline::runLosslessCrop(const ItemPtr &item) {
+    // JPEG z HTTP + ustawiony ROI: obrót i wycięcie na współczynnikach DCT,
+    // bez dekodowania i ponownego kodowania
+    QByteArray cropped;
+    QSize size;
+    if (!JpegTransform::cropLossless(item->payload, item->req.rotation, item->req.roi, cropped, size))
+        return false;
+
+    if (!storeImage(item, cropped.constData(), cropped.size())) {
+        finishCpu(item, false, "File write error");
+        return true;
+    }
+
+    if (item->network) {
+        ScanTrace::CameraResponse r;
+        r.camIndex = item->req.camIndex;
+        r.bytes = item->payload.size();
+        r.latencyMs = item->fetchMs;
+        r.width = size.width();
+        r.height = size.height();
+        ScanTraceRecorder::instance().recordCamera(r);
+    }
+
+    item->payload.clear();
+    finishCpu(item, true, "");
+    return true;
+}
+
+bool CapturePipeline::storeImage(const ItemPtr &item, const char *data, qint64 size) {
+    if (item->req.spool) {
+        item->location = ImageSpool::instance().append(item->req.palletCode, item->req.camIndex, data, size);
+        if (!item->location.isEmpty()) return true;
+        // Spool pełny (niewysłane zdjęcia w każdym segmencie) - zdjęcie nie ginie, idzie do tmp/
+    }
+
+    QFile file(item->req.savePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data, size) != size) return false;
+    item->location = item->req.savePath;
+    return true;
+}
+
+bool CapturePipeline::runPassthrough(const ItemPtr &item) {
+    // Gotowy JPEG ze źródła lokalnego bez obrotu i ROI - zapis bajtów, bez dekodowania
+    if (!item->cachedJpeg || item->req.rotation != 0 || !item->req.roi.isEmpty()) return false;
+    // Strojony JPEG (progresywny, Huffman, podpróbkowanie) wymaga ponownego kodowania
+    if (item->req.encoder.format != ImageEncoder::Jpeg) return false;
+
+    if (!storeImage(item, item->payload.constData(), item->payload.size())) {
+        finishCpu(item, false, "File write error");
+        return true;
+    }
+
+    item->payload.clear();
+    finishCpu(item, true, "");
+    return true;
+}
+
+void CapturePipeline::runDecode(const ItemPtr &item) {
+    if (runPassthrough(item)) return;
+    // Wycięcie na DCT tylko dla zwykłego JPEG - zachowuje kodowanie źródła, nie ustawienia strojonego
+    if (!item->req.roi.isEmpty() && !item->payload.isEmpty()
+        && item->req.encoder.format == ImageEncoder::Jpeg && runLosslessCrop(item)) return;
+
+    FramePool &pool = FramePool::forCamera(item->req.camIndex);
+    const qint64 payloadBytes = item->payload.size();
+
+    if (!item->payload.isEmpty()) {
+        // constData - bajty ze źródła lokalnego są współdzielone, bez odłączania kopii
+        const cv::Mat raw(1, int(item->payload.size()), CV_8UC1, const_cast<char*>(item->payload.constData()));
+        // Przy błędzie imdecode nie rusza dst (i zwraca go) - bufor z puli trzymałby poprzednie
+        // zdjęcie, więc dekodujemy do osobnej macierzy i podmieniamy dopiero po sukcesie
+        cv::Mat decoded = cv::imdecode(raw, cv::IMREAD_COLOR);
+        item->payload.clear();
+        if (decoded.empty()) {
+            finishCpu(item, false, "Invalid image data");
+            return;
+        }
+        std::swap(item->frame, decoded);
+        pool.release(decoded);
+    }
+
+    if (item->network) {
+        ScanTrace::CameraResponse r;
+        r.camIndex = item->req.camIndex;
+        r.bytes = payloadBytes > 0 ? payloadBytes : qint64(item->frame.total() * item->frame.elemSize());
+        r.latencyMs = item->fetchMs;
+        r.width = item->frame.cols;
+        r.height = item->frame.rows;
+        ScanTraceRecorder::instance().recordCamera(r);
+    }
+
+    if (item->req.rotation != 0) {
+        int code = item->req.rotation == 90 ? cv::ROTATE_90_CLOCKWISE
+                 : item->req.rotation == 180 ? cv::ROTATE_180 : cv::ROTATE_90_COUNTERCLOCKWISE;
+        item->rotated = FramePool::forCamera(item->req.camIndex, FramePool::Rotated).acquire();
+        cv::rotate(item->frame, item->rotated, code);
+    }
+
+    // Kodowanie jako osobny etap - pula przeplata je z dekodowaniem kolejnych klatek
+    m_cpuPool->start([this, item]() { runEncode(item); });
+}
+
+void CapturePipeline::runEncode(const ItemPtr &item) {
+    // Klatka zostaje w BGR - kodery imgcodecs nie potrzebują konwersji do RGB
+    cv::Mat output = item->rotated.empty() ? item->frame : item->rotated;
+
+    // ROI to tylko widok na bufor (bez kopii) - koduje się wyłącznie wycięty fragment
+    const QRect r = JpegTransform::roiToPixels(item->req.roi, output.cols, output.rows);
+    if (r.size() != QSize(output.cols, output.rows))
+        output = output(cv::Rect(r.x(), r.y(), r.width(), r.height()));
+
+    // Koder z ustawień (JPEG / strojony JPEG / WebP / AVIF / JPEG XL), zapis do spoolu albo pliku
+    std::vector<uchar> encoded;
+    const bool written = ImageEncoder::encode(output, item->req.encoder, encoded)
+                      && storeImage(item, reinterpret_cast<const char*>(encoded.data()), qint64(encoded.size()));
+    if (!written) {
+        finishCpu(item, false, "File write error");
+        return;
+    }
+    finishCpu(item, true, "");
+}
+
+void CapturePipeline::finishCpu(const ItemPtr &item, bool success, const QString &errorMsg) {
+    // Najpierw rezerwacja - bufory odkładane do puli liczą się już jako trzymane
+    MemoryBudget::global().release(item->reserved);
+    FramePool::forCamera(item->req.camIndex).release(item->frame);
+    FramePool::forCamera(item->req.camIndex, FramePool::Rotated).release(item->rotated);
+
+    // Hand-off: sygnał trafia do GUI kolejką, slot CPU zwalniamy na wątku potoku
+    emit resultReady(item->req.camIndex, success, success ? item->location : item->req.savePath, errorMsg,
+                     item->req.scanId);
+    QMetaObject::invokeMethod(this, [this]() {
+        m_cpuBusy--;
+        pump();
+    }, Qt::QueuedConnection);
+}
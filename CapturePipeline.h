@@ -0,0 +1,67 @@
+#ifndef CAPTUREPIPELINE_H
+#define CAPTUREPIPELINE_H
+
+#include <QObject>
+#include <QQueue>
+#include <QThreadPool>
+#include <QtNetwork>
+#include <memory>
+#include <opencv2/core.hpp>
+#include "CameraSource.h"
+
+class ReplayCameraLayer;
+
+// --- POTOK PRZECHWYTYWANIA (fetch -> decode/transform -> encode -> hand-off) ---
+// Obiekt żyje na własnym wątku I/O: tam działa asynchroniczny QNetworkAccessManager
+// i tam są liczone sloty. Blokujące RTSP idzie na pulę I/O, dekodowanie, obrót
+// i kodowanie na pulę CPU o rozmiarze liczby rdzeni fizycznych.
+// Etap pobrania deleguje do CameraSource wybranego per kamera (CaptureRequest::source).
+// Kolejki między etapami są ograniczone - nadmiar żądań czeka w m_pending.
+class CapturePipeline : public QObject {
+    Q_OBJECT
+public:
+    explicit CapturePipeline(QObject *parent = nullptr);
+    ~CapturePipeline() override;
+
+    // Tryb odtwarzania śladu: zamiast kamer nagrane odpowiedzi (wywoływać na wątku potoku)
+    void setReplayLayer(std::shared_ptr<ReplayCameraLayer> layer);
+
+public slots:
+    void submit(const CaptureRequest &req);
+
+signals:
+    void resultReady(int index, bool success, const QString &filePath, const QString &errorMsg, quint64 scanId);
+    // true, gdy trwają pobrania z kamer (sieć zajęta) - upload może wtedy ustąpić
+    void captureActivityChanged(bool active);
+
+private:
+    using ItemPtr = CaptureItemPtr;
+
+    void pump();
+    void updateActivity();
+    CameraSource *sourceFor(const CaptureRequest &req) const;
+    void onFetched(const ItemPtr &item, const QString &errorMsg);
+    bool storeImage(const ItemPtr &item, const char *data, qint64 size);
+    bool runPassthrough(const ItemPtr &item);
+    bool runLosslessCrop(const ItemPtr &item);
+    void runDecode(const ItemPtr &item);
+    void runEncode(const ItemPtr &item);
+    void finishCpu(const ItemPtr &item, bool success, const QString &errorMsg);
+
+    QNetworkAccessManager *m_netMan;
+    QThreadPool *m_ioPool;
+    QThreadPool *m_cpuPool;
+    std::unique_ptr<CameraSource> m_sources[CameraSource::KindCount];
+    std::unique_ptr<CameraSource> m_replaySource; // Gdy ustawione - zastępuje wszystkie kamery
+
+    // Stan etapów - dotykany wyłącznie z wątku potoku
+    QQueue<CaptureRequest> m_pending;
+    QQueue<ItemPtr> m_fetched;
+    int m_fetching;     // Pobierane + pobrane czekające na CPU
+    int m_netFetching;  // Pobierane przez sieć (bez źródeł lokalnych)
+    int m_cpuBusy;      // W dekodowaniu / kodowaniu
+    int m_cpuCapacity;
+    bool m_active;
+};
+
+#endif
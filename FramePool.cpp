@@ -0,0 +1,87 @@
+#include "FramePool.h"
+#include <QMutexLocker>
+
+namespace {
+const int kMaxCameras = 5;
+const int kMaxFreePerCamera = 3;                        // Bufory trzymane między skanami
+const qint64 kDefaultFrameBytes = 3840LL * 2160 * 3;    // 4K BGR, zanim poznamy realny rozmiar
+}
+
+// =========================================================
+// MEMORY BUDGET
+// =========================================================
+MemoryBudget::MemoryBudget() : m_limit(1024LL * 1024 * 1024), m_used(0), m_retained(0) {}
+
+MemoryBudget &MemoryBudget::global() {
+    static MemoryBudget budget;
+    return budget;
+}
+
+void MemoryBudget::setLimit(qint64 bytes) {
+    QMutexLocker lock(&m_mutex);
+    m_limit = bytes;
+}
+
+bool MemoryBudget::tryAcquire(qint64 bytes) {
+    QMutexLocker lock(&m_mutex);
+    // Pojedyncze żądanie większe niż limit przechodzi, gdy nic innego nie trzyma pamięci
+    if (m_used > 0 && m_used + m_retained + bytes > m_limit) return false;
+    m_used += bytes;
+    return true;
+}
+
+void MemoryBudget::release(qint64 bytes) {
+    QMutexLocker lock(&m_mutex);
+    m_used = qMax<qint64>(0, m_used - bytes);
+}
+
+qint64 MemoryBudget::used() const {
+    QMutexLocker lock(&m_mutex);
+    return m_used;
+}
+
+bool MemoryBudget::tryRetain(qint64 bytes) {
+    QMutexLocker lock(&m_mutex);
+    if (m_used + m_retained + bytes > m_limit) return false;
+    m_retained += bytes;
+    return true;
+}
+
+void MemoryBudget::unretain(qint64 bytes) {
+    QMutexLocker lock(&m_mutex);
+    m_retained = qMax<qint64>(0, m_retained - bytes);
+}
+
+// =========================================================
+// FRAME POOL
+// =========================================================
+FramePool::FramePool() : m_frameBytes(kDefaultFrameBytes) {}
+
+FramePool &FramePool::forCamera(int index, Role role) {
+    static FramePool pools[kMaxCameras][RoleCount];
+    return pools[qBound(0, index, kMaxCameras - 1)][role == Rotated ? Rotated : Frame];
+}
+
+cv::Mat FramePool::acquire() {
+    QMutexLocker lock(&m_mutex);
+    if (m_free.isEmpty()) return cv::Mat();
+    cv::Mat mat = m_free.takeLast();
+    // Od teraz bufor pokrywa rezerwacja przechwycenia
+    MemoryBudget::global().unretain(qint64(mat.total() * mat.elemSize()));
+    return mat;
+}
+
+void FramePool::release(cv::Mat &mat) {
+    QMutexLocker lock(&m_mutex);
+    if (!mat.empty()) {
+        const qint64 bytes = qint64(mat.total() * mat.elemSize());
+        m_frameBytes = bytes;
+        if (m_free.size() < kMaxFreePerCamera && MemoryBudget::global().tryRetain(bytes)) m_free.append(mat);
+    }
+    mat = cv::Mat();
+}
+
+qint64 FramePool::expectedCaptureBytes() const {
+    QMutexLocker lock(&m_mutex);
+    return 2 * m_frameBytes;
+}
@@ -0,0 +1,59 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QMutex>
+#include <QList>
+#include <opencv2/core.hpp>
+
+// --- GLOBALNY BUDŻET PAMIĘCI (backpressure dla nowych przechwyceń) ---
+// Przechwycenie rezerwuje szacowaną liczbę bajtów przed pobraniem klatki;
+// gdy budżet jest wyczerpany, potok wstrzymuje nowe pobrania zamiast zwiększać RSS.
+// Bufory trzymane w pulach między skanami też się liczą, ale nie blokują przechwycenia,
+// gdy nic innego nie trzyma pamięci (przechwycenie i tak przejmie bufor z puli).
+class MemoryBudget {
+public:
+    static MemoryBudget &global();
+
+    void setLimit(qint64 bytes);
+    bool tryAcquire(qint64 bytes);
+    void release(qint64 bytes);
+    qint64 used() const;
+
+    // Bufor odkładany do puli - false = przekroczyłby limit, lepiej go zwolnić
+    bool tryRetain(qint64 bytes);
+    void unretain(qint64 bytes);
+
+private:
+    MemoryBudget();
+
+    mutable QMutex m_mutex;
+    qint64 m_limit;
+    qint64 m_used;
+    qint64 m_retained;
+};
+
+// --- PULA BUFORÓW KLATEK (na kamerę i rolę bufora, współdzielona między skanami) ---
+// cv::Mat::create() nie realokuje, gdy rozmiar i typ się zgadzają, więc
+// bufor z puli jest używany ponownie przy każdym kolejnym skanie. Klatka i bufor
+// po obrocie mają osobne pule - przy 90/270 kształty są transponowane.
+class FramePool {
+public:
+    enum Role { Frame = 0, Rotated = 1, RoleCount };
+
+    static FramePool &forCamera(int index, Role role = Frame);
+
+    cv::Mat acquire();
+    void release(cv::Mat &mat);
+
+    // Szacunek pamięci jednego przechwycenia (klatka + bufor po obrocie)
+    qint64 expectedCaptureBytes() const;
+
+private:
+    FramePool();
+
+    mutable QMutex m_mutex;
+    QList<cv::Mat> m_free;
+    qint64 m_frameBytes;
+};
+
+#endif
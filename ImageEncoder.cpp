@@ -0,0 +1,221 @@
+#include "ImageEncoder.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QList>
+#include <QStringList>
+#include <cstdio>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+// Stałe koderów pojawiały się w kolejnych wersjach imgcodecs
+#define MAGAZYN_CV_AT_LEAST(major, minor) \
+    (CV_VERSION_MAJOR > (major) || (CV_VERSION_MAJOR == (major) && CV_VERSION_MINOR >= (minor)))
+
+namespace {
+const int kBenchRepeats = 3;
+
+std::vector<int> encoderParams(const ImageEncoder::Settings &s) {
+    switch (s.format) {
+    case ImageEncoder::JpegTuned: {
+        std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, s.quality,
+                                    cv::IMWRITE_JPEG_PROGRESSIVE, s.progressive ? 1 : 0,
+                                    cv::IMWRITE_JPEG_OPTIMIZE, s.optimize ? 1 : 0 };
+#if MAGAZYN_CV_AT_LEAST(4, 6)
+        params.push_back(cv::IMWRITE_JPEG_SAMPLING_FACTOR);
+        params.push_back(s.subsampling == 444 ? cv::IMWRITE_JPEG_SAMPLING_FACTOR_444
+                       : s.subsampling == 422 ? cv::IMWRITE_JPEG_SAMPLING_FACTOR_422
+                                              : cv::IMWRITE_JPEG_SAMPLING_FACTOR_420);
+#endif
+        return params;
+    }
+    case ImageEncoder::WebP:
+        return { cv::IMWRITE_WEBP_QUALITY, qBound(1, s.quality, 100) };
+#if MAGAZYN_CV_AT_LEAST(4, 8)
+    case ImageEncoder::Avif:
+        return { cv::IMWRITE_AVIF_QUALITY, s.quality, cv::IMWRITE_AVIF_SPEED, 8 };
+#endif
+#if MAGAZYN_CV_AT_LEAST(4, 11)
+    case ImageEncoder::JpegXl:
+        return { cv::IMWRITE_JPEGXL_QUALITY, s.quality, cv::IMWRITE_JPEGXL_EFFORT, 3 };
+#endif
+    default:
+        return { cv::IMWRITE_JPEG_QUALITY, s.quality };
+    }
+}
+}
+
+bool ImageEncoder::isAvailable(int format) {
+    switch (format) {
+    case Jpeg:
+    case JpegTuned:
+        return true;
+    case WebP:
+        return cv::haveImageWriter(".webp");
+    case Avif:
+        return MAGAZYN_CV_AT_LEAST(4, 8) && cv::haveImageWriter(".avif");
+    case JpegXl:
+        return MAGAZYN_CV_AT_LEAST(4, 11) && cv::haveImageWriter(".jxl");
+    default:
+        return false;
+    }
+}
+
+const char *ImageEncoder::name(int format) {
+    switch (format) {
+    case JpegTuned: return "JPEG (libjpeg-turbo, strojony)";
+    case WebP: return "WebP";
+    case Avif: return "AVIF";
+    case JpegXl: return "JPEG XL";
+    default: return "JPEG";
+    }
+}
+
+const char *ImageEncoder::extension(int format) {
+    switch (format) {
+    case WebP: return ".webp";
+    case Avif: return ".avif";
+    case JpegXl: return ".jxl";
+    default: return ".jpg";
+    }
+}
+
+const char *ImageEncoder::mimeType(int format) {
+    switch (format) {
+    case WebP: return "image/webp";
+    case Avif: return "image/avif";
+    case JpegXl: return "image/jxl";
+    default: return "image/jpeg";
+    }
+}
+
+ImageEncoder::Settings ImageEncoder::effective(const Settings &settings) {
+    Settings s = settings;
+    s.quality = qBound(1, s.quality, 100);
+    if (!isAvailable(s.format)) s.format = Jpeg;
+    return s;
+}
+
+bool ImageEncoder::encode(const cv::Mat &bgr, const Settings &settings, std::vector<uchar> &out) {
+    const Settings s = effective(settings);
+    return cv::imencode(extension(s.format), bgr, out, encoderParams(s));
+}
+
+int ImageEncoder::sniff(const QByteArray &data) {
+    if (data.startsWith("\xFF\xD8")) return Jpeg;
+    if (data.startsWith("\xFF\x0A") || data.startsWith(QByteArray("\0\0\0\x0CJXL ", 8))) return JpegXl;
+    if (data.startsWith("RIFF") && data.mid(8, 4) == "WEBP") return WebP;
+    const QByteArray brand = data.mid(4, 8);
+    if (brand == "ftypavif" || brand == "ftypavis") return Avif;
+    return -1;
+}
+
+const char *ImageEncoder::mimeTypeForFile(const QString &fileName) {
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    if (suffix == "webp") return mimeType(WebP);
+    if (suffix == "avif") return mimeType(Avif);
+    if (suffix == "jxl") return mimeType(JpegXl);
+    return mimeType(Jpeg);
+}
+
+QImage ImageEncoder::decodeScaled(const QByteArray &data, const QSize &size) {
+    if (data.isEmpty() || size.isEmpty()) return QImage();
+    const cv::Mat raw(1, int(data.size()), CV_8UC1, const_cast<char*>(data.constData()));
+    const cv::Mat bgr = cv::imdecode(raw, cv::IMREAD_COLOR);
+    if (bgr.empty()) return QImage();
+
+    const QSize target = QSize(bgr.cols, bgr.rows).scaled(size, Qt::KeepAspectRatio);
+    cv::Mat small;
+    cv::resize(bgr, small, cv::Size(qMax(1, target.width()), qMax(1, target.height())), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small, small, cv::COLOR_BGR2RGB);
+    return QImage(small.data, small.cols, small.rows, int(small.step), QImage::Format_RGB888).copy();
+}
+
+// =========================================================
+// ENCODER BENCHMARK (--encoder-bench)
+// =========================================================
+int ImageEncoder::runBenchmark(const QString &inputPath) {
+    QStringList files;
+    const QFileInfo info(inputPath);
+    if (info.isDir()) {
+        const QFileInfoList entries = QDir(inputPath).entryInfoList({ "*.jpg", "*.jpeg", "*.png" }, QDir::Files);
+        for (const QFileInfo &entry : entries) files << entry.absoluteFilePath();
+    } else if (info.isFile()) {
+        files << info.absoluteFilePath();
+    }
+
+    std::vector<cv::Mat> images;
+    for (const QString &file : files) {
+        cv::Mat img = cv::imread(file.toStdString(), cv::IMREAD_COLOR);
+        if (!img.empty()) images.push_back(img);
+    }
+    if (images.empty()) {
+        fprintf(stderr, "encoder-bench: brak zdjęć w %s\n", qPrintable(inputPath));
+        return 1;
+    }
+
+    struct Result {
+        QString label;
+        bool available;
+        double bytes = 0;
+        double ms = 0;
+        double psnr = 0;
+    };
+
+    QList<Settings> configs;
+    for (int quality : { 75, 85, 90 }) {
+        Settings s;
+        s.quality = quality;
+        s.format = Jpeg;
+        configs << s;
+        s.format = JpegTuned;
+        s.subsampling = 420;
+        configs << s;
+        s.subsampling = 444;
+        configs << s;
+        s.subsampling = 420;
+        for (int format : { WebP, Avif, JpegXl }) {
+            s.format = format;
+            configs << s;
+        }
+    }
+
+    QList<Result> results;
+    double baselineBytes = 0;
+    for (const Settings &s : configs) {
+        Result r;
+        r.label = QString("%1 q%2").arg(name(s.format)).arg(s.quality);
+        if (s.format == JpegTuned) r.label += QString(" %1").arg(s.subsampling);
+        r.available = isAvailable(s.format);
+        if (r.available) {
+            std::vector<uchar> out;
+            QElapsedTimer timer;
+            for (const cv::Mat &img : images) {
+                timer.start();
+                for (int k = 0; k < kBenchRepeats; k++) encode(img, s, out);
+                r.ms += timer.nsecsElapsed() / 1e6 / kBenchRepeats;
+                r.bytes += double(out.size());
+
+                const cv::Mat decoded = cv::imdecode(out, cv::IMREAD_COLOR);
+                if (!decoded.empty()) r.psnr += cv::PSNR(img, decoded);
+            }
+            r.bytes /= images.size();
+            r.ms /= images.size();
+            r.psnr /= images.size();
+            if (s.format == Jpeg && s.quality == 85) baselineBytes = r.bytes;
+        }
+        results << r;
+    }
+
+    printf("encoder-bench: %zu zdjęć, %d powtórzeń, OpenCV %s\n", images.size(), kBenchRepeats, CV_VERSION);
+    printf("%-40s %12s %10s %10s %9s\n", "koder", "B/zdjęcie", "ms/zdjęcie", "vs JPEG85", "PSNR dB");
+    for (const Result &r : results) {
+        if (!r.available) {
+            printf("%-40s %12s\n", qPrintable(r.label), "niedostępny");
+            continue;
+        }
+        printf("%-40s %12.0f %10.2f %9.0f%% %9.2f\n", qPrintable(r.label), r.bytes, r.ms,
+               baselineBytes > 0 ? 100.0 * r.bytes / baselineBytes : 0.0, r.psnr);
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// --- KODER ZDJĘĆ (format wyjściowy wybierany per wdrożenie) ---
+// Wszystko przez imgcodecs OpenCV: JPEG idzie przez libjpeg(-turbo) z opcjami
+// progresywny / optymalizacja Huffmana / podpróbkowanie chrominancji, WebP/AVIF/JPEG XL
+// tylko gdy OpenCV ma dany koder (isAvailable) - inaczej zostaje JPEG.
+namespace ImageEncoder {
+
+enum Format { Jpeg = 0, JpegTuned = 1, WebP = 2, Avif = 3, JpegXl = 4, FormatCount };
+
+struct Settings {
+    int format = Jpeg;
+    int quality = 85;
+    bool progressive = true;  // Tylko JpegTuned
+    bool optimize = true;     // Tylko JpegTuned
+    int subsampling = 420;    // Tylko JpegTuned: 420 / 422 / 444
+};
+
+bool isAvailable(int format);
+const char *name(int format);
+const char *extension(int format);  // ".jpg", ".webp", ...
+const char *mimeType(int format);
+
+// Niedostępny format -> Jpeg z tą samą jakością
+Settings effective(const Settings &settings);
+bool encode(const cv::Mat &bgr, const Settings &settings, std::vector<uchar> &out);
+
+// Format rozpoznany po sygnaturze danych (spool, upload), -1 = nieznany
+int sniff(const QByteArray &data);
+const char *mimeTypeForFile(const QString &fileName);
+
+// Podgląd formatów, których nie czyta QImageReader (AVIF/JXL bez wtyczek Qt)
+QImage decodeScaled(const QByteArray &data, const QSize &size);
+
+// --encoder-bench: bajty na zdjęcie vs czas kodowania vs PSNR dla wszystkich koderów
+int runBenchmark(const QString &inputPath);
+
+}
+
+#endif
@@ -0,0 +1,406 @@
+#include "ImageSpool.h"
+#include "Metrics.h"
+#include "ImageEncoder.h"
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+namespace {
+const quint32 kFileMagic = 0x4D53504C;   // 'MSPL'
+const quint32 kRecordMagic = 0x4D535052; // 'MSPR'
+const quint32 kVersion = 1;
+const int kSegmentCount = 8;
+const qint64 kFileHeaderSize = 4096;
+const qint64 kMinSegmentSize = 4 * 1024 * 1024;
+
+enum RecordState : quint32 { StateWritten = 1, StateUploaded = 2, StateFailed = 3, StateDiscarded = 4 };
+
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 segmentCount;
+    quint32 reserved;
+    qint64 segmentSize;
+};
+
+struct RecordHeader {
+    quint32 magic;      // Ustawiany na końcu zapisu - rekord bez magii nie istnieje
+    quint32 state;
+    quint32 sequence;   // Rosnący w obrębie pliku, wyznacza głowicę zapisu po restarcie
+    quint32 length;
+    quint32 crc32;
+    qint32 camIndex;
+    qint64 capturedMs;  // Od epoki, UTC
+    char pallet[96];    // UTF-8, zakończony zerem
+};
+static_assert(sizeof(RecordHeader) == 128, "RecordHeader must stay 128 bytes");
+
+qint64 alignUp(qint64 value) {
+    return (value + 7) & ~qint64(7);
+}
+
+quint32 crc32(const uchar *data, qint64 size) {
+    static const std::array<quint32, 256> table = []() {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; i++) {
+            quint32 c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    quint32 c = 0xFFFFFFFFu;
+    for (qint64 i = 0; i < size; i++) c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+ImageSpool::Record describe(const RecordHeader *h, qint64 offset) {
+    ImageSpool::Record r;
+    r.location = QString("spool:%1:%2").arg(offset).arg(h->sequence);
+    r.palletCode = QString::fromUtf8(h->pallet, int(strnlen(h->pallet, sizeof(h->pallet))));
+    r.camIndex = h->camIndex;
+    r.capturedAt = QDateTime::fromMSecsSinceEpoch(h->capturedMs);
+    return r;
+}
+}
+
+// =========================================================
+// IMAGE SPOOL
+// =========================================================
+ImageSpool &ImageSpool::instance() {
+    static ImageSpool spool;
+    return spool;
+}
+
+ImageSpool::ImageSpool()
+    : m_base(nullptr), m_segmentSize(0), m_writeSegment(0), m_writeOffset(0), m_sequence(1) {}
+
+bool ImageSpool::open(const QString &path, qint64 sizeBytes) {
+    QMutexLocker lock(&m_mutex);
+    if (m_base) return true;
+
+    const qint64 segmentSize = ((sizeBytes - kFileHeaderSize) / kSegmentCount) & ~qint64(4095);
+    if (segmentSize < kMinSegmentSize) return false;
+    const qint64 fileSize = kFileHeaderSize + segmentSize * kSegmentCount;
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qCritical() << "SPOOL: cannot open" << path << m_file.errorString();
+        return false;
+    }
+
+    bool fresh = m_file.size() != fileSize;
+    if (fresh) {
+        if (!m_file.resize(fileSize)) {
+            m_file.close();
+            return false;
+        }
+#ifdef Q_OS_LINUX
+        // Bloki przydzielone od razu - zapis przez mapowanie nie skończy się SIGBUS przy pełnym dysku
+        if (posix_fallocate(m_file.handle(), 0, fileSize) != 0)
+            qWarning() << "SPOOL: posix_fallocate failed, file may be sparse";
+#endif
+    }
+
+    m_base = m_file.map(0, fileSize);
+    if (!m_base) {
+        qCritical() << "SPOOL: mmap failed" << m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    auto *header = reinterpret_cast<FileHeader*>(m_base);
+    if (fresh || header->magic != kFileMagic || header->version != kVersion
+            || header->segmentCount != quint32(kSegmentCount) || header->segmentSize != segmentSize) {
+        memset(m_base, 0, size_t(kFileHeaderSize));
+        for (int s = 0; s < kSegmentCount; s++)
+            reinterpret_cast<RecordHeader*>(m_base + kFileHeaderSize + s * segmentSize)->magic = 0;
+        header->magic = kFileMagic;
+        header->version = kVersion;
+        header->segmentCount = kSegmentCount;
+        header->segmentSize = segmentSize;
+        fresh = true;
+    }
+
+    m_segmentSize = segmentSize;
+    m_segments = QVector<Segment>(kSegmentCount);
+    if (!fresh) recover();
+    publishStats();
+
+    qDebug() << "SPOOL:" << path << fileSize / (1024 * 1024) << "MB," << kSegmentCount << "segments,"
+             << m_recovered.size() << "records to resend";
+    return true;
+}
+
+bool ImageSpool::isOpen() const {
+    QMutexLocker lock(&m_mutex);
+    return m_base != nullptr;
+}
+
+void ImageSpool::recover() {
+    // Indeks odbudowany z nagłówków: skan segmentu kończy się na pierwszym slocie bez magii
+    quint32 maxSequence = 0;
+    for (int s = 0; s < m_segments.size(); s++) {
+        uchar *segment = m_base + kFileHeaderSize + s * m_segmentSize;
+        qint64 offset = 0;
+        while (offset + qint64(sizeof(RecordHeader)) <= m_segmentSize) {
+            auto *h = reinterpret_cast<RecordHeader*>(segment + offset);
+            if (h->magic != kRecordMagic) break;
+            if (qint64(h->length) > m_segmentSize - offset - qint64(sizeof(RecordHeader))) break;
+
+            const qint64 next = offset + alignUp(qint64(sizeof(RecordHeader)) + h->length);
+            if (h->sequence >= maxSequence) {
+                maxSequence = h->sequence;
+                m_writeSegment = s;
+                m_writeOffset = next;
+            }
+
+            const bool intact = crc32(segment + offset + sizeof(RecordHeader), h->length) == h->crc32;
+            if (!intact) {
+                qWarning() << "SPOOL: CRC mismatch, dropping record" << h->sequence;
+            } else if (h->state == StateWritten || h->state == StateFailed) {
+                // Niewysłane i nieudane z poprzedniego uruchomienia - ponowna wysyłka
+                h->state = StateWritten;
+                m_segments[s].pending++;
+                m_recovered.append(describe(h, kFileHeaderSize + s * m_segmentSize + offset));
+            }
+            offset = next;
+        }
+    }
+    m_sequence = maxSequence + 1;
+
+    std::sort(m_recovered.begin(), m_recovered.end(), [](const Record &a, const Record &b) {
+        return a.capturedAt < b.capturedAt;
+    });
+}
+
+QString ImageSpool::append(const QString &palletCode, int camIndex, const char *data, qint64 size) {
+    const qint64 need = alignUp(qint64(sizeof(RecordHeader)) + size);
+    uchar *slot = nullptr;
+    qint64 offset = 0;
+    quint32 sequence = 0;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (!m_base || need > m_segmentSize) return QString();
+
+        if (m_writeOffset + need > m_segmentSize) {
+            // Recykling: następny segment tylko, gdy wszystko z niego już wysłano
+            const int next = (m_writeSegment + 1) % m_segments.size();
+            if (m_segments[next].pending > 0) {
+                Metrics::add("spool_full_total", 1);
+                return QString();
+            }
+#ifdef Q_OS_LINUX
+            // Zamknięty segment zlecamy do zapisu na dysk (w tle) - po zaniku zasilania
+            // tracimy najwyżej bieżący segment; awaria samego procesu nie traci nic (page cache)
+            msync(m_base + kFileHeaderSize + m_writeSegment * m_segmentSize, size_t(m_segmentSize), MS_ASYNC);
+#endif
+            m_writeSegment = next;
+            m_writeOffset = 0;
+            Metrics::add("spool_segments_recycled_total", 1);
+        }
+
+        uchar *segment = m_base + kFileHeaderSize + m_writeSegment * m_segmentSize;
+        offset = kFileHeaderSize + m_writeSegment * m_segmentSize + m_writeOffset;
+        slot = segment + m_writeOffset;
+        reinterpret_cast<RecordHeader*>(slot)->magic = 0;
+
+        m_writeOffset += need;
+        // Terminator za rekordem - odtwarzanie nie wejdzie w stare dane z poprzedniego obiegu
+        if (m_writeOffset + qint64(sizeof(RecordHeader)) <= m_segmentSize)
+            reinterpret_cast<RecordHeader*>(segment + m_writeOffset)->magic = 0;
+
+        m_segments[m_writeSegment].pending++;
+        sequence = m_sequence++;
+        publishStats();
+    }
+
+    // Kopia danych poza blokadą - slot należy już wyłącznie do tego wywołania
+    memcpy(slot + sizeof(RecordHeader), data, size_t(size));
+
+    RecordHeader h;
+    memset(&h, 0, sizeof(h));
+    h.state = StateWritten;
+    h.sequence = sequence;
+    h.length = quint32(size);
+    h.crc32 = crc32(slot + sizeof(RecordHeader), size);
+    h.camIndex = camIndex;
+    h.capturedMs = QDateTime::currentMSecsSinceEpoch();
+    const QByteArray pallet = palletCode.toUtf8().left(int(sizeof(h.pallet)) - 1);
+    memcpy(h.pallet, pallet.constData(), size_t(pallet.size()));
+    memcpy(slot, &h, sizeof(h));
+    reinterpret_cast<RecordHeader*>(slot)->magic = kRecordMagic;
+
+    Metrics::add("spool_bytes_written_total", double(size));
+    return QString("spool:%1:%2").arg(offset).arg(sequence);
+}
+
+uchar *ImageSpool::recordAt(const QString &location) const {
+    if (!m_base) return nullptr;
+    const QStringList parts = location.split(':');
+    if (parts.size() != 3) return nullptr;
+
+    const qint64 offset = parts[1].toLongLong();
+    const quint32 sequence = parts[2].toUInt();
+    if (offset < kFileHeaderSize || offset + qint64(sizeof(RecordHeader)) > m_file.size()) return nullptr;
+
+    // Numer w lokalizacji chroni przed odczytem rekordu, który nadpisał już nowy obieg
+    auto *h = reinterpret_cast<RecordHeader*>(m_base + offset);
+    if (h->magic != kRecordMagic || h->sequence != sequence) return nullptr;
+    return m_base + offset;
+}
+
+void ImageSpool::release(const QString &location, bool uploaded) {
+    if (!isSpoolLocation(location)) return;
+
+    QMutexLocker lock(&m_mutex);
+    uchar *slot = recordAt(location);
+    if (!slot) return;
+
+    auto *h = reinterpret_cast<RecordHeader*>(slot);
+    if (h->state != StateWritten) return;
+    if (!uploaded) {
+        // Nieudana wysyłka: rekord dalej blokuje recykling segmentu i czeka na takeFailed()
+        h->state = StateFailed;
+        m_failed.append(describe(h, slot - m_base));
+        publishStats();
+        return;
+    }
+    h->state = StateUploaded;
+    m_segments[int((slot - m_base - kFileHeaderSize) / m_segmentSize)].pending--;
+    publishStats();
+}
+
+void ImageSpool::discard(const QString &location) {
+    if (!isSpoolLocation(location)) return;
+
+    QMutexLocker lock(&m_mutex);
+    uchar *slot = recordAt(location);
+    if (!slot) return;
+
+    auto *h = reinterpret_cast<RecordHeader*>(slot);
+    if (h->state != StateWritten && h->state != StateFailed) return;
+    if (h->state == StateFailed) {
+        m_failed.erase(std::remove_if(m_failed.begin(), m_failed.end(),
+                                      [&](const Record &r) { return r.location == location; }), m_failed.end());
+    }
+    h->state = StateDiscarded;
+    m_segments[int((slot - m_base - kFileHeaderSize) / m_segmentSize)].pending--;
+    publishStats();
+}
+
+bool ImageSpool::relabel(const QString &location, const QString &palletCode) {
+    if (!isSpoolLocation(location)) return false;
+
+    QMutexLocker lock(&m_mutex);
+    uchar *slot = recordAt(location);
+    if (!slot) return false;
+
+    // CRC obejmuje tylko dane - paletę podmieniamy w miejscu
+    auto *h = reinterpret_cast<RecordHeader*>(slot);
+    if (h->state != StateWritten) return false;
+    const QByteArray pallet = palletCode.toUtf8().left(int(sizeof(h->pallet)) - 1);
+    memset(h->pallet, 0, sizeof(h->pallet));
+    memcpy(h->pallet, pallet.constData(), size_t(pallet.size()));
+    return true;
+}
+
+QList<ImageSpool::Record> ImageSpool::takeRecovered() {
+    QMutexLocker lock(&m_mutex);
+    QList<Record> recovered;
+    recovered.swap(m_recovered);
+    return recovered;
+}
+
+QList<ImageSpool::Record> ImageSpool::takeFailed() {
+    QMutexLocker lock(&m_mutex);
+    QList<Record> failed;
+    for (const Record &record : m_failed) {
+        // Z powrotem w wysyłce - kolejne niepowodzenie znów trafi do m_failed
+        auto *h = reinterpret_cast<RecordHeader*>(recordAt(record.location));
+        if (!h || h->state != StateFailed) continue;
+        h->state = StateWritten;
+        failed.append(record);
+    }
+    m_failed.clear();
+    publishStats();
+    return failed;
+}
+
+void ImageSpool::publishStats() {
+    int pending = 0;
+    for (const Segment &segment : m_segments) pending += segment.pending;
+    Metrics::set("spool_records_pending", pending);
+    Metrics::set("spool_records_failed", m_failed.size());
+}
+
+bool ImageSpool::isSpoolLocation(const QString &location) {
+    return location.startsWith("spool:");
+}
+
+QByteArray ImageSpool::load(const QString &location) {
+    if (!isSpoolLocation(location)) {
+        QFile file(location);
+        if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+        return file.readAll();
+    }
+
+    ImageSpool &spool = instance();
+    QMutexLocker lock(&spool.m_mutex);
+    uchar *slot = spool.recordAt(location);
+    if (!slot) return QByteArray();
+
+    // Widok na mapowanie bez kopii - ważny do release() (segment nie pójdzie do recyklingu)
+    const auto *h = reinterpret_cast<const RecordHeader*>(slot);
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(slot + sizeof(RecordHeader)), int(h->length));
+}
+
+QIODevice *ImageSpool::openDevice(const QString &location, QObject *parent) {
+    if (!isSpoolLocation(location)) {
+        auto *file = new QFile(location, parent);
+        if (!file->open(QIODevice::ReadOnly)) {
+            delete file;
+            return nullptr;
+        }
+        return file;
+    }
+
+    const QByteArray data = load(location);
+    if (data.isEmpty()) return nullptr;
+    auto *buffer = new QBuffer(parent);
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+QString ImageSpool::fileName(const QString &location) {
+    if (!isSpoolLocation(location)) return QFileInfo(location).fileName();
+
+    ImageSpool &spool = instance();
+    QMutexLocker lock(&spool.m_mutex);
+    uchar *slot = spool.recordAt(location);
+    if (!slot) return QString();
+
+    // Ta sama nazwa co dla plików w tmp/ - serwer nie widzi różnicy między trybami
+    // Rozszerzenie z sygnatury danych - rekord nie pamięta, jakim koderem powstał
+    const auto *h = reinterpret_cast<const RecordHeader*>(slot);
+    const Record r = describe(h, 0);
+    const QByteArray head = QByteArray::fromRawData(reinterpret_cast<const char*>(slot + sizeof(RecordHeader)),
+                                                    int(qMin<quint64>(h->length, 16)));
+    const int format = ImageEncoder::sniff(head);
+    return QString("%1_%2_%3%4").arg(r.palletCode, r.capturedAt.toString("yyyyMMdd-HHmm")).arg(r.camIndex)
+                                .arg(ImageEncoder::extension(format < 0 ? ImageEncoder::Jpeg : format));
+}
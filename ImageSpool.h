@@ -0,0 +1,78 @@
+#ifndef IMAGESPOOL_H
+#define IMAGESPOOL_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+class QObject;
+
+// --- SPOOL ZDJĘĆ (jeden prealokowany plik mapowany w pamięć, pierścień segmentów) ---
+// Zamiast pliku na każde zdjęcie w tmp/: rekordy [nagłówek 128 B | JPEG] dopisywane
+// kolejno w segmencie. Nagłówek = indeks: paleta, kamera, czas (ms), długość, CRC32, stan.
+// Zdjęcie identyfikuje lokalizacja "spool:<offset>:<nr>" - przechodzi przez potok, UploadJob
+// i podgląd tak jak ścieżka pliku. Segment jest nadpisywany dopiero, gdy wszystkie jego
+// rekordy zostały wysłane albo odrzucone - nieudane czekają na ponowienie. Na dysk
+// zlecamy zapis (msync) przy przejściu do następnego segmentu. Bezpieczny wątkowo.
+class ImageSpool {
+public:
+    struct Record {
+        QString location;
+        QString palletCode;
+        int camIndex;
+        QDateTime capturedAt;
+    };
+
+    static ImageSpool &instance();
+
+    bool open(const QString &path, qint64 sizeBytes);
+    bool isOpen() const;
+
+    // Pusty wynik = brak miejsca (wszystkie segmenty mają niewysłane zdjęcia)
+    QString append(const QString &palletCode, int camIndex, const char *data, qint64 size);
+    // Po wysyłce: udana odblokowuje recykling segmentu, nieudana czeka na takeFailed()
+    void release(const QString &location, bool uploaded);
+    // Zdjęcie do wyrzucenia bez (kolejnej) wysyłki - szum, odrzucone przez serwer; odblokowuje recykling
+    void discard(const QString &location);
+    // Kod palety dopisany po zapisie (przechwytywanie spekulatywne) - false = rekordu już nie ma
+    bool relabel(const QString &location, const QString &palletCode);
+    // Niewysłane rekordy z poprzedniego uruchomienia (odczytane przy open)
+    QList<Record> takeRecovered();
+    // Rekordy po nieudanej wysyłce - do ponownego wysłania (wracają do stanu "zapisany")
+    QList<Record> takeFailed();
+
+    // Dostęp jednolity dla plików i rekordów spoola (spool: bez kopii, widok na mapowanie)
+    static bool isSpoolLocation(const QString &location);
+    static QByteArray load(const QString &location);
+    static QIODevice *openDevice(const QString &location, QObject *parent = nullptr);
+    static QString fileName(const QString &location);
+
+private:
+    ImageSpool();
+
+    struct Segment {
+        int pending = 0; // Zapisane lub nieudane - jeszcze nie wysłane ani odrzucone
+    };
+
+    uchar *recordAt(const QString &location) const; // Wymaga m_mutex, nullptr = nieważna
+    void recover();
+    void publishStats();
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    uchar *m_base;
+    qint64 m_segmentSize;
+    QVector<Segment> m_segments;
+    int m_writeSegment;
+    qint64 m_writeOffset; // Względem początku segmentu
+    quint32 m_sequence;
+    QList<Record> m_recovered;
+    QList<Record> m_failed; // Nieudane, trzymają segment do ponowienia
+};
+
+#endif
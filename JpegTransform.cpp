@@ -0,0 +1,83 @@
+#include "JpegTransform.h"
+#include <QDebug>
+#include <cmath>
+#include <utility>
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+QRect JpegTransform::roiToPixels(const QRectF &roi, int width, int height) {
+    const QRect full(0, 0, width, height);
+    if (roi.isEmpty()) return full;
+
+    QRect r(int(std::lround(roi.x() * width)), int(std::lround(roi.y() * height)),
+            int(std::lround(roi.width() * width)), int(std::lround(roi.height() * height)));
+    r = r.intersected(full);
+    return r.isEmpty() ? full : r;
+}
+
+bool JpegTransform::cropLossless(const QByteArray &jpeg, int rotation, const QRectF &roi,
+                                 QByteArray &out, QSize &outSize)
+{
+#ifdef HAVE_TURBOJPEG
+    if (roi.isEmpty() || jpeg.size() < 4 || uchar(jpeg[0]) != 0xFF || uchar(jpeg[1]) != 0xD8) return false;
+
+    tjhandle handle = tjInitTransform();
+    if (!handle) return false;
+
+    const auto *src = reinterpret_cast<const unsigned char*>(jpeg.constData());
+    const unsigned long srcSize = (unsigned long)jpeg.size();
+    int width = 0, height = 0, subsamp = 0, colorspace = 0;
+    if (tjDecompressHeader3(handle, src, srcSize, &width, &height, &subsamp, &colorspace) != 0
+        || subsamp < 0) {
+        tjDestroy(handle);
+        return false;
+    }
+
+    tjtransform xform = {};
+    int mcuW = tjMCUWidth[subsamp];
+    int mcuH = tjMCUHeight[subsamp];
+    if (rotation == 90 || rotation == 270) {
+        xform.op = rotation == 90 ? TJXOP_ROT90 : TJXOP_ROT270;
+        std::swap(width, height);
+        std::swap(mcuW, mcuH);
+    } else if (rotation == 180) {
+        xform.op = TJXOP_ROT180;
+    }
+
+    // ROI jest w układzie obrazu po obrocie - tak samo liczy go TurboJPEG.
+    // TJXOPT_TRIM obcina niepełne MCU: 90° prawą krawędź, 270° dolną, 180° obie.
+    if (rotation == 90 || rotation == 180) width -= width % mcuW;
+    if (rotation == 180 || rotation == 270) height -= height % mcuH;
+
+    QRect r = roiToPixels(roi, width, height);
+    const int alignedX = r.x() - r.x() % mcuW;
+    const int alignedY = r.y() - r.y() % mcuH;
+    r.setLeft(alignedX);
+    r.setTop(alignedY);
+
+    xform.r.x = r.x();
+    xform.r.y = r.y();
+    xform.r.w = r.width();
+    xform.r.h = r.height();
+    xform.options = TJXOPT_CROP | TJXOPT_TRIM;
+
+    unsigned char *dst = nullptr;
+    unsigned long dstSize = 0;
+    const bool ok = tjTransform(handle, src, srcSize, 1, &dst, &dstSize, &xform, 0) == 0;
+    if (ok) {
+        out = QByteArray(reinterpret_cast<const char*>(dst), qsizetype(dstSize));
+        outSize = r.size();
+    } else {
+        qWarning() << "JpegTransform: lossless crop failed:" << tjGetErrorStr2(handle);
+    }
+
+    tjFree(dst);
+    tjDestroy(handle);
+    return ok;
+#else
+    Q_UNUSED(jpeg); Q_UNUSED(rotation); Q_UNUSED(roi); Q_UNUSED(out); Q_UNUSED(outSize);
+    return false;
+#endif
+}
@@ -0,0 +1,23 @@
+#ifndef JPEGTRANSFORM_H
+#define JPEGTRANSFORM_H
+
+#include <QByteArray>
+#include <QRectF>
+#include <QRect>
+#include <QSize>
+
+namespace JpegTransform {
+
+// ROI zapisany w ustawieniach jako ułamki (0..1) obrazu po obrocie -> piksele
+QRect roiToPixels(const QRectF &roi, int width, int height);
+
+// Bezstratny obrót + wycięcie ROI w dziedzinie DCT (TurboJPEG), bez dekodowania.
+// Początek ROI jest wyrównywany w dół do granicy MCU, więc wynik może być
+// o kilka pikseli większy od żądanego. Zwraca false, gdy się nie da (brak
+// TurboJPEG, dane nie-JPEG, błąd transformacji) - wtedy zostaje ścieżka z dekodowaniem.
+bool cropLossless(const QByteArray &jpeg, int rotation, const QRectF &roi,
+                  QByteArray &out, QSize &outSize);
+
+}
+
+#endif
@@ -10,119 +10,311 @@
 #include <QThread>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QHttpMultiPart>
+#include <QBuffer>
 #include <QUrlQuery>
 #include <QDebug>
 #include <QPainter>
 #include <QEventLoop>
 #include <QFileDialog>  
 #include <QInputDialog> 
+#include <QImageReader>
+#include <QStyle>
+#include <QFontDatabase>
+#include "StartupProfiler.h"
+#include "PgSink.h"
+#include "FramePool.h"
+#include "Metrics.h"
+#include "StatusOverlay.h"
+#include "StallWatchdog.h"
+#include "ImageSpool.h"
+#include "ImageEncoder.h"
+
+static const qint64 kYieldFloorBytesPerSec = 128 * 1024; // Dławienie w trakcie przechwytywania bez limitu
+static const int kMaxOutstandingPerEndpoint = 2; // Wysyłki naraz do jednego serwera
+static const int kMaxEndpointFailures = 3;       // Kolejne błędy, po których serwer wypada z puli
+static const int kHealthCheckMs = 5000;
+static const double kEwmaAlpha = 0.3;
+static const int kSpeculativeWindowMs = 500; // Przerwa między znakami - skaner wysyła kod w 50-150 ms
 
 // =========================================================
-// CAMERA WORKER
+// UPLOAD WORKER
 // =========================================================
-CameraWorker::CameraWorker(int index, QString url, int protocolMode, int rotation,
-                           QString user, QString pass, QString savePath, QObject *parent)
-    : QObject(parent), m_index(index), m_url(url), m_protocol(protocolMode),
-      m_rotation(rotation), m_user(user), m_pass(pass), m_savePath(savePath)
+UploadWorker::UploadWorker(const QStringList &serverUrls, int timeout, QObject *parent)
+    : UploadSink(parent), m_inFlight(0), m_timeout(timeout),
+      m_rateCap(0), m_yieldToCapture(false), m_captureActive(false)
 {
-    setAutoDelete(true);
-}
-
-void CameraWorker::run() {
-    QImage capturedImg;
-    bool success = false;
-    QString errorMsg = "";
-
-    if (m_protocol == 0) {
-        QNetworkAccessManager netMan;
-        QNetworkRequest request(m_url);
-
-        QString concatenated = m_user + ":" + m_pass;
-        QByteArray data = concatenated.toLocal8Bit().toBase64();
-        request.setRawHeader("Authorization", "Basic " + data);
-        request.setTransferTimeout(5000);
-
-        QEventLoop loop;
-        QObject::connect(&netMan, &QNetworkAccessManager::finished, &loop, &QEventLoop::quit);
-        QNetworkReply *reply = netMan.get(request);
-        loop.exec();
-
-        if (reply->error() == QNetworkReply::NoError) {
-            QByteArray imgData = reply->readAll();
-            if (capturedImg.loadFromData(imgData)) {
-                success = true;
-            } else {
-                errorMsg = "Invalid image data";
-            }
+    manager = new QNetworkAccessManager(this);
+
+    m_deferTimer = new QTimer(this);
+    m_deferTimer->setSingleShot(true);
+    connect(m_deferTimer, &QTimer::timeout, this, &UploadWorker::processNext);
+
+    m_healthTimer = new QTimer(this);
+    m_healthTimer->setInterval(kHealthCheckMs);
+    connect(m_healthTimer, &QTimer::timeout, this, &UploadWorker::checkEndpoints);
+
+    setEndpoints(serverUrls);
+}
+
+void UploadWorker::addJob(const UploadJob &job) {
+    UploadJob queued = job;
+    queued.enqueuedAt = QDateTime::currentDateTime();
+    // Zadania przychodzą w kolejności skanów - najnowsza paleta jest "bieżąca"
+    // (ponowienia ze spoola zostają w swojej klasie: zaległe albo po terminie)
+    if (!job.retry) m_currentPallet = job.palletCode;
+    m_queue.append(queued);
+    publishStats();
+    processNext();
+}
+
+void UploadWorker::updateConfig(const QStringList &serverUrls, int timeout) {
+    qDebug() << "UploadWorker: new config" << serverUrls << "timeout" << timeout
+             << "(queued:" << m_queue.size() << ")";
+    m_timeout = timeout;
+    setEndpoints(serverUrls);
+    processNext();
+}
+
+// =========================================================
+// UPLOAD ENDPOINTS (równoważenie, failover, sprawdzanie zdrowia)
+// =========================================================
+void UploadWorker::setEndpoints(const QStringList &urls) {
+    // Statystyki serwerów, które zostały na liście, przechodzą do nowej konfiguracji
+    QList<Endpoint> endpoints;
+    for (const QString &url : urls) {
+        if (const Endpoint *old = findEndpoint(url)) {
+            endpoints.append(*old);
         } else {
-            errorMsg = "HTTP Error: " + reply->errorString();
+            Endpoint endpoint;
+            endpoint.url = url;
+            endpoints.append(endpoint);
         }
-        reply->deleteLater();
     }
-    else {
-        cv::VideoCapture cap;
-        cap.open(m_url.toStdString(), cv::CAP_FFMPEG);
-
-        if (cap.isOpened()) {
-            cv::Mat frame;
-            for(int k=0; k<20; k++) {
-                if(cap.read(frame) && !frame.empty()) {
-                    cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
-                    capturedImg = QImage((const uchar*)frame.data, frame.cols, frame.rows, frame.step, QImage::Format_RGB888).copy();
-                    success = true;
-                    break;
-                }
+    m_endpoints = endpoints;
+    publishEndpointStats();
+}
+
+UploadWorker::Endpoint *UploadWorker::findEndpoint(const QString &url) {
+    for (Endpoint &endpoint : m_endpoints) {
+        if (endpoint.url == url) return &endpoint;
+    }
+    return nullptr;
+}
+
+int UploadWorker::pickEndpoint(const QString &avoid) const {
+    // Najmniej wysyłek w toku, ważone średnim czasem - wolny serwer dostaje mniej.
+    // Serwer bez próbek wygrywa remis (szybko się go uczymy). Ponowienie omija poprzedni serwer.
+    int best = -1;
+    double bestScore = 0;
+    for (int pass = 0; pass < 2 && best == -1; ++pass) {
+        for (int i = 0; i < m_endpoints.size(); ++i) {
+            const Endpoint &ep = m_endpoints[i];
+            if (!ep.healthy || ep.outstanding >= kMaxOutstandingPerEndpoint) continue;
+            if (pass == 0 && !avoid.isEmpty() && ep.url == avoid) continue;
+
+            const double score = (ep.outstanding + 1) * qMax(1.0, ep.ewmaMs);
+            if (best == -1 || score < bestScore) {
+                best = i;
+                bestScore = score;
             }
-            if(!success) errorMsg = "RTSP Decode Failed";
-            cap.release();
-        } else {
-            errorMsg = "RTSP Connection Failed";
         }
     }
+    return best;
+}
 
-    if (success && !capturedImg.isNull()) {
-        if (m_rotation != 0) {
-            QTransform trans;
-            trans.rotate(m_rotation == 270 ? -90 : m_rotation);
-            capturedImg = capturedImg.transformed(trans);
-        }
+void UploadWorker::recordEndpointResult(const QString &url, bool ok, qint64 elapsedMs) {
+    Endpoint *ep = findEndpoint(url);
+    if (!ep) return; // Usunięty z konfiguracji w trakcie wysyłki
+    ep->outstanding--;
 
-        if (!capturedImg.save(m_savePath, "JPG", 85)) {
-            success = false;
-            errorMsg = "File write error";
-        }
+    // Błąd liczy się jak timeout - odrzucone połączenie nie może wyglądać na szybki serwer
+    const double sample = ok ? double(elapsedMs) : double(qMax<qint64>(elapsedMs, m_timeout * 1000));
+    ep->ewmaMs = ep->ewmaMs > 0 ? kEwmaAlpha * sample + (1 - kEwmaAlpha) * ep->ewmaMs : sample;
+
+    if (ok) {
+        ep->failures = 0;
+        return;
+    }
+    if (++ep->failures >= kMaxEndpointFailures && ep->healthy) {
+        qCritical() << "UploadWorker: endpoint down" << ep->url << "after" << ep->failures << "failures";
+        ep->healthy = false;
+        Metrics::add("upload_endpoint_down_total", 1);
+        publishEndpointStats();
+        if (!m_healthTimer->isActive()) m_healthTimer->start();
     }
+}
 
-    emit resultReady(m_index, success, m_savePath, errorMsg);
+void UploadWorker::checkEndpoints() {
+    bool anyDown = false;
+    for (Endpoint &ep : m_endpoints) {
+        if (ep.healthy) continue;
+        anyDown = true;
+        if (ep.probing) continue;
+
+        // HEAD na adres uploadu: każda odpowiedź HTTP poniżej 500 = serwer żyje
+        ep.probing = true;
+        Metrics::add("upload_health_checks_total", 1);
+        QNetworkRequest request{QUrl(ep.url)};
+        request.setTransferTimeout(m_timeout * 1000);
+        QNetworkReply *reply = manager->head(request);
+        const QString url = ep.url;
+        connect(reply, &QNetworkReply::finished, this, [this, reply, url]() {
+            reply->deleteLater();
+            Endpoint *ep = findEndpoint(url);
+            if (!ep) return;
+            ep->probing = false;
+
+            const QVariant status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+            if (!status.isValid() || status.toInt() >= 500) return;
+
+            qDebug() << "UploadWorker: endpoint back" << url;
+            ep->healthy = true;
+            ep->failures = 0;
+            ep->ewmaMs = 0; // Po restarcie serwera czasy uczymy się od nowa
+            Metrics::add("upload_endpoint_recovered_total", 1);
+            publishEndpointStats();
+            processNext();
+        });
+    }
+    if (!anyDown) m_healthTimer->stop();
 }
 
-// =========================================================
-// UPLOAD WORKER
-// =========================================================
-UploadWorker::UploadWorker(QString serverUrl, int timeout, QObject *parent)
-    : QObject(parent), m_serverUrl(serverUrl), m_timeout(timeout), m_isUploading(false)
-{
-    manager = new QNetworkAccessManager(this);
+void UploadWorker::publishEndpointStats() {
+    int healthy = 0;
+    for (const Endpoint &ep : m_endpoints) {
+        if (ep.healthy) healthy++;
+    }
+    Metrics::set("upload_endpoints", m_endpoints.size());
+    Metrics::set("upload_endpoints_healthy", healthy);
 }
 
-void UploadWorker::addJob(const UploadJob &job) {
-    m_queue.enqueue(job);
+void UploadWorker::setPolicy(const UploadPolicy &policy) {
+    m_policy = policy;
     processNext();
 }
 
+void UploadWorker::setRateLimit(int kbps, bool yieldToCapture) {
+    m_rateCap = qint64(kbps) * 1024;
+    m_yieldToCapture = yieldToCapture;
+    applyRate();
+}
+
+void UploadWorker::setCaptureActive(bool active) {
+    m_captureActive = active;
+    applyRate();
+}
+
+void UploadWorker::applyRate() {
+    // W trakcie serii zdjęć ustępujemy kamerom: 10% limitu (lub stałe minimum bez limitu)
+    const bool yielding = m_yieldToCapture && m_captureActive;
+    const qint64 rate = yielding ? qMax(kYieldFloorBytesPerSec, m_rateCap / 10) : m_rateCap;
+    m_bucket.setRate(yielding && m_rateCap > 0 ? qMin(rate, m_rateCap) : rate);
+    Metrics::set("upload_rate_limit_bytes", double(m_bucket.rate()));
+    Metrics::set("upload_yielding", yielding ? 1 : 0);
+}
+
+UploadWorker::JobClass UploadWorker::classify(const UploadJob &job, const QDateTime &now) const {
+    if (job.palletCode == m_currentPallet) return ClassCurrent;
+    if (job.deadline.isValid() && job.deadline < now) return ClassExpired;
+    return ClassBacklog;
+}
+
+bool UploadWorker::isOffPeak(const QDateTime &now) const {
+    const int hour = now.time().hour();
+    if (m_policy.offPeakFrom <= m_policy.offPeakTo)
+        return hour >= m_policy.offPeakFrom && hour < m_policy.offPeakTo;
+    return hour >= m_policy.offPeakFrom || hour < m_policy.offPeakTo; // Przez północ
+}
+
+int UploadWorker::pickNext(bool &downgrade) const {
+    const QDateTime now = QDateTime::currentDateTime();
+    const bool deferExpired = m_policy.backlog == UploadPolicy::BacklogDeferOffPeak && !isOffPeak(now);
+
+    int best = -1;
+    JobClass bestClass = ClassExpired;
+    QDateTime bestKey;
+    for (int i = 0; i < m_queue.size(); ++i) {
+        const UploadJob &job = m_queue[i];
+        const JobClass cls = classify(job, now);
+        if (cls == ClassExpired && deferExpired) continue;
+
+        // Bieżąca: FIFO, w terminie: najbliższy termin (EDF), po terminie: najstarsze
+        const QDateTime key = cls == ClassCurrent ? job.enqueuedAt
+                            : cls == ClassBacklog ? job.deadline : job.capturedAt;
+        if (best == -1 || cls < bestClass || (cls == bestClass && key < bestKey)) {
+            best = i;
+            bestClass = cls;
+            bestKey = key;
+        }
+    }
+
+    downgrade = best != -1 && bestClass == ClassExpired && m_policy.backlog == UploadPolicy::BacklogDowngrade;
+    return best;
+}
+
 void UploadWorker::processNext() {
-    if (m_isUploading || m_queue.isEmpty()) return;
+    if (m_endpoints.isEmpty() && !m_queue.isEmpty()) {
+        // Bez serwera zdjęcia czekałyby w kolejce bez końca - błąd od razu (spool ponowi później)
+        qCritical() << "UploadWorker: No upload server configured, dropping" << m_queue.size() << "jobs";
+        QList<UploadJob> jobs;
+        jobs.swap(m_queue);
+        for (const UploadJob &job : jobs) {
+            ImageSpool::instance().release(job.filePath, false);
+            emit uploadFinished(job.camIndex, false, "No upload server configured");
+        }
+        publishStats();
+        return;
+    }
+
+    while (!m_queue.isEmpty()) {
+        bool downgrade = false;
+        const int index = pickNext(downgrade);
+        if (index == -1) {
+            // Zostały tylko odłożone zaległe - sprawdzamy ponownie za minutę
+            if (!m_deferTimer->isActive()) m_deferTimer->start(60 * 1000);
+            return;
+        }
+
+        // Wszystkie serwery zajęte albo poza pulą - wracamy po odpowiedzi / udanym sprawdzeniu
+        const int endpoint = pickEndpoint(m_queue[index].endpoint);
+        if (endpoint == -1) return;
+
+        UploadJob job = m_queue.takeAt(index);
+        sendRequest(job, downgrade, endpoint);
+    }
+}
+
+void UploadWorker::publishStats() {
+    QDateTime oldest;
+    for (const UploadJob &job : m_queue) {
+        if (!oldest.isValid() || job.enqueuedAt < oldest) oldest = job.enqueuedAt;
+    }
+    emit queueStatsChanged(m_queue.size() + m_inFlight, oldest);
+}
 
-    m_isUploading = true;
-    UploadJob job = m_queue.head();
-    sendRequest(job);
+void UploadWorker::finishJob(const UploadJob &job, bool success, const QString &msg, bool rejected) {
+    m_inFlight--;
+    if (rejected) {
+        // Odrzucone przez serwer - ponowienie nic nie da, rekord nie może trzymać segmentu
+        Metrics::add("upload_rejected_total", 1);
+        ImageSpool::instance().discard(job.filePath);
+    } else {
+        ImageSpool::instance().release(job.filePath, success);
+    }
+    emit uploadFinished(job.camIndex, success, msg);
+    publishStats();
+    processNext();
 }
 
-void UploadWorker::sendRequest(const UploadJob &job) {
+void UploadWorker::sendRequest(UploadJob job, bool downgrade, int endpoint) {
+    m_inFlight++;
+    job.attempts++;
+    job.endpoint = m_endpoints[endpoint].url;
     emit uploadStarted(job.camIndex);
 
-    QUrl url(m_serverUrl);
+    QUrl url(job.endpoint);
     QUrlQuery query;
     query.addQueryItem("sulabel", job.palletCode);
     query.addQueryItem("cam", QString::number(job.camIndex));
@@ -132,108 +324,331 @@ void UploadWorker::sendRequest(const UploadJob &job) {
     QNetworkRequest request(url);
     request.setTransferTimeout(m_timeout * 1000);
 
-    QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
-    QHttpPart imagePart;
-    imagePart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("image/jpeg"));
-    imagePart.setHeader(QNetworkRequest::ContentDispositionHeader,
-        QVariant(QString("form-data; name=\"photo\"; filename=\"%1\"").arg(QFileInfo(job.filePath).fileName())));
+    QString fileName = ImageSpool::fileName(job.filePath);
+    QByteArray mimeType = ImageEncoder::mimeTypeForFile(fileName);
+    const bool throttled = m_rateCap > 0 || m_yieldToCapture;
 
-    QFile *file = new QFile(job.filePath);
-    if (!file->open(QIODevice::ReadOnly)) {
+    // Plik strumieniujemy z dysku, rekord spoola prosto z mapowania (bez kopii);
+    // bajty w ręku tylko przy zmniejszaniu lub dławieniu
+    QIODevice *file = nullptr;
+    QByteArray payload;
+    if (downgrade || throttled) payload = ImageSpool::load(job.filePath);
+    else file = ImageSpool::openDevice(job.filePath);
+
+    if (!file && payload.isEmpty()) {
         qCritical() << "UploadWorker: File error" << job.filePath;
-        delete multiPart; delete file;
-        m_isUploading = false;
-        m_queue.dequeue();
-        emit uploadFinished(job.camIndex, false, "File Access Error");
-        processNext();
+        finishJob(job, false, "File Access Error", true);
         return;
     }
 
-    imagePart.setBodyDevice(file);
-    file->setParent(multiPart);
-    multiPart->append(imagePart);
+    if (downgrade) {
+        // Zaległe po terminie: połowa rozdzielczości, niższa jakość - mniej bajtów w szczycie.
+        // Wynik zawsze JPEG (WebP/AVIF/JXL czyta tylko Qt z wtyczkami, wtedy wysyłamy oryginał)
+        QImage img;
+        QByteArray small;
+        if (img.loadFromData(payload)) {
+            QBuffer buffer(&small);
+            buffer.open(QIODevice::WriteOnly);
+            img.scaled(img.size() / 2, Qt::KeepAspectRatio, Qt::SmoothTransformation).save(&buffer, "JPG", 70);
+        }
+        if (!small.isEmpty()) {
+            qDebug() << "UploadWorker: Downgraded backlog" << job.filePath << payload.size() << "->" << small.size();
+            payload = small;
+            fileName = QFileInfo(fileName).completeBaseName() + ".jpg";
+            mimeType = ImageEncoder::mimeType(ImageEncoder::Jpeg);
+        }
+    }
 
-    QNetworkReply *reply = manager->post(request, multiPart);
-    multiPart->setParent(reply);
+    QNetworkReply *reply = nullptr;
+    if (throttled) {
+        // Ciało multipart składane ręcznie - QHttpMultiPart nie daje się dławić
+        const QByteArray boundary = "----MagazynSkaner" + QByteArray::number(QDateTime::currentMSecsSinceEpoch(), 16);
+        QByteArray body;
+        body.reserve(payload.size() + 512);
+        body += "--" + boundary + "\r\n";
+        body += "Content-Disposition: form-data; name=\"photo\"; filename=\"" + fileName.toUtf8() + "\"\r\n";
+        body += "Content-Type: " + mimeType + "\r\n\r\n";
+        body += payload;
+        body += "\r\n--" + boundary + "--\r\n";
+
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "multipart/form-data; boundary=" + boundary);
+        request.setHeader(QNetworkRequest::ContentLengthHeader, body.size());
+        request.setAttribute(QNetworkRequest::DoNotBufferUploadDataAttribute, true);
+
+        auto *device = new ThrottledUploadDevice(body, &m_bucket);
+        reply = manager->post(request, device);
+        device->setParent(reply);
+    } else {
+        QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+        QHttpPart imagePart;
+        imagePart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant(mimeType));
+        imagePart.setHeader(QNetworkRequest::ContentDispositionHeader,
+            QVariant(QString("form-data; name=\"photo\"; filename=\"%1\"").arg(fileName)));
+
+        if (file) {
+            imagePart.setBodyDevice(file);
+            file->setParent(multiPart);
+        } else {
+            imagePart.setBody(payload);
+        }
+        multiPart->append(imagePart);
 
-    connect(reply, &QNetworkReply::finished, [this, reply, job]() {
-        bool success = (reply->error() == QNetworkReply::NoError);
-        QString msg = success ? "OK" : reply->errorString();
+        reply = manager->post(request, multiPart);
+        multiPart->setParent(reply);
+    }
 
-        if(success) qDebug() << "Upload Success Cam" << job.camIndex;
-        else qCritical() << "Upload Failed Cam" << job.camIndex << msg;
+    m_endpoints[endpoint].outstanding++;
+    QElapsedTimer timer;
+    timer.start();
+    connect(reply, &QNetworkReply::finished, this, [this, reply, job, timer]() {
+        onReplyFinished(reply, job, timer.elapsed());
+    });
+}
 
-        reply->deleteLater();
-        m_queue.dequeue();
-        m_isUploading = false;
-        emit uploadFinished(job.camIndex, success, msg);
+void UploadWorker::onReplyFinished(QNetworkReply *reply, const UploadJob &job, qint64 elapsedMs) {
+    bool success = (reply->error() == QNetworkReply::NoError);
+    QString msg = success ? "OK" : reply->errorString();
+    reply->deleteLater();
+
+    // Brak odpowiedzi HTTP (sieć, timeout) albo 5xx - wina serwera, 4xx - wina zdjęcia
+    const QVariant status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+    const bool endpointFault = !success && (!status.isValid() || status.toInt() >= 500);
+    recordEndpointResult(job.endpoint, !endpointFault, elapsedMs);
+
+    if(success) qDebug() << "Upload Success Cam" << job.camIndex << job.endpoint;
+    else qCritical() << "Upload Failed Cam" << job.camIndex << job.endpoint << msg;
+
+    // Failover: zdjęcie wraca do kolejki (ten sam priorytet), następna próba na innym serwerze
+    if (endpointFault && m_endpoints.size() > 1 && job.attempts < m_endpoints.size()) {
+        Metrics::add("upload_failovers_total", 1);
+        m_inFlight--;
+        m_queue.append(job);
+        publishStats();
         processNext();
-    });
+        return;
+    }
+    finishJob(job, success, msg, !success && !endpointFault);
 }
 
 // =========================================================
 // MAIN WINDOW
 // =========================================================
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+MainWindow::MainWindow(QWidget *parent)
+    : QMainWindow(parent), settingsDialog(nullptr), openSpeculativeScan(0), nextScanId(1), uploadQueueDepth(0) {
     this->setObjectName("mainWindow");
 
     qputenv("OPENCV_FFMPEG_CAPTURE_OPTIONS", "rtsp_transport;tcp");
     qputenv("OPENCV_VIDEOIO_PRIORITY_GSTREAMER", "0");
 
-    settingsDialog = new SettingDialog(this);
-
-    int w = settingsDialog->getAppWidth();
-    int h = settingsDialog->getAppHeight();
-    bool fs = settingsDialog->isFullScreen();
-
-    if (fs) {
-        this->setWindowFlags(Qt::Window | Qt::FramelessWindowHint);
-        this->showFullScreen();
-    } else {
-        this->setWindowFlags(Qt::Window);
-        this->resize(w, h);
-        this->show();
-    }
-
     serialScanner = new QSerialPort(this);
 
-    cameraPool = QThreadPool::globalInstance();
-    cameraPool->setMaxThreadCount(8);
-
-    uploadThread = new QThread(this);
-    uploadWorker = new UploadWorker(settingsDialog->getServerUrl(), settingsDialog->getUploadTimeout());
-    uploadWorker->moveToThread(uploadThread);
-
-    connect(uploadThread, &QThread::finished, uploadWorker, &QObject::deleteLater);
-    connect(this, &MainWindow::requestUpload, uploadWorker, &UploadWorker::addJob);
-    connect(uploadWorker, &UploadWorker::uploadStarted, this, &MainWindow::onWorkerUploadStarted);
-    connect(uploadWorker, &UploadWorker::uploadFinished, this, &MainWindow::onWorkerUploadFinished);
-
-    uploadThread->start();
+    MemoryBudget::global().setLimit(qint64(SettingDialog::getMemoryBudgetMb()) * 1024 * 1024);
 
     ensureTmpFolderExists();
     setupStyles();
     setupUi();
+    updateClock();
 
     secretShortcut = new QShortcut(QKeySequence("Ctrl+5"), this);
     connect(secretShortcut, &QShortcut::activated, this, &MainWindow::openSettings);
 
+    speculativeTimer = new QTimer(this);
+    speculativeTimer->setSingleShot(true);
+    speculativeTimer->setInterval(kSpeculativeWindowMs);
+    // Bufory skanera zostają - wolno wpisywany kod kończy się zwykłym skanem po Enterze
+    connect(speculativeTimer, &QTimer::timeout, this, &MainWindow::discardSpeculativeScan);
+
     testShortcut = new QShortcut(QKeySequence("Ctrl+4"), this);
     connect(testShortcut, &QShortcut::activated, this, &MainWindow::openTestImageDialog);
 
     QShortcut *exitShortcut = new QShortcut(QKeySequence("Ctrl+Q"), this);
     connect(exitShortcut, &QShortcut::activated, qApp, &QApplication::quit);
+    StartupProfiler::mark("MainWindow: UI");
+
+    // Okno pokazujemy dopiero z gotowym UI (bez pustej klatki przy starcie kiosku)
+    applyWindowMode();
+    StartupProfiler::mark("MainWindow: shown");
+
+    uploadThread = new QThread(this);
+    uploadSink = createUploadSink();
+    uploadSink->moveToThread(uploadThread);
+
+    connect(uploadThread, &QThread::finished, uploadSink, &QObject::deleteLater);
+    connect(this, &MainWindow::requestUpload, uploadSink, &UploadSink::addJob);
+    connect(uploadSink, &UploadSink::uploadStarted, this, &MainWindow::onWorkerUploadStarted);
+    connect(uploadSink, &UploadSink::uploadFinished, this, &MainWindow::onWorkerUploadFinished);
+    if (auto *worker = qobject_cast<UploadWorker*>(uploadSink)) {
+        connect(worker, &UploadWorker::queueStatsChanged, this, &MainWindow::onUploadQueueStats);
+    }
+
+    uploadThread->start();
+    applyUploadPolicy();
+    applyUploadRate();
+
+    captureThread = new QThread(this);
+    capturePipeline = new CapturePipeline();
+    capturePipeline->moveToThread(captureThread);
+
+    connect(captureThread, &QThread::finished, capturePipeline, &QObject::deleteLater);
+    connect(this, &MainWindow::requestCapture, capturePipeline, &CapturePipeline::submit);
+    connect(capturePipeline, &CapturePipeline::resultReady, this, &MainWindow::onCameraFinished);
+    if (auto *worker = qobject_cast<UploadWorker*>(uploadSink)) {
+        connect(capturePipeline, &CapturePipeline::captureActivityChanged, worker, &UploadWorker::setCaptureActive);
+    }
+
+    captureThread->start();
+    StartupProfiler::mark("MainWindow: upload/capture threads");
+
+    // Otwarcie portu szeregowego może blokować - po pierwszym przebiegu pętli zdarzeń
+    QTimer::singleShot(0, this, &MainWindow::finishStartup);
+}
+
+UploadSink *MainWindow::createUploadSink() {
+    uploadSinkType = SettingDialog::getUploadSink();
+    if (uploadSinkType == 1) {
+        qDebug() << "Upload sink: PostgreSQL";
+        return new PgUploadSink(SettingDialog::getPgConnInfo(), SettingDialog::getPgStoreImages());
+    }
+    qDebug() << "Upload sink: HTTP" << SettingDialog::getServerUrls();
+    return new UploadWorker(SettingDialog::getServerUrls(), SettingDialog::getUploadTimeout());
+}
+
+bool MainWindow::startReplay(const QString &tracePath, double speed) {
+    auto *replayer = new ScanTraceReplayer(this);
+    if (!replayer->load(tracePath, speed)) {
+        delete replayer;
+        return false;
+    }
 
+    // Warstwa kamer ustawiana kolejką - dotrze do potoku przed pierwszym żądaniem
+    replayLayer = replayer->cameraLayer();
+    CapturePipeline *pipeline = capturePipeline;
+    std::shared_ptr<ReplayCameraLayer> layer = replayLayer;
+    QMetaObject::invokeMethod(pipeline, [pipeline, layer]() {
+        pipeline->setReplayLayer(layer);
+    }, Qt::QueuedConnection);
+
+    connect(replayer, &ScanTraceReplayer::scanReplayed, this, [this](const QString &code) {
+        currentPalletCode = code;
+        startScanProcess();
+    });
+    // Surowe wejście przez tę samą obsługę co na żywo - niezależnie od ustawionego portu
+    connect(replayer, &ScanTraceReplayer::inputReplayed, this, [this](int source, int key, const QByteArray &data) {
+        if (source == ScanTrace::SourceSerial) processSerialData(data);
+        else processKey(key, QString::fromUtf8(data));
+    });
+    headerTitle->setText("ODTWARZANIE ŚLADU");
+    replayer->start();
+    return true;
+}
+
+void MainWindow::applyUploadPolicy() {
+    auto *worker = qobject_cast<UploadWorker*>(uploadSink);
+    if (!worker) return;
+
+    UploadPolicy policy;
+    policy.backlog = SettingDialog::getBacklogPolicy();
+    policy.offPeakFrom = SettingDialog::getOffPeakFrom();
+    policy.offPeakTo = SettingDialog::getOffPeakTo();
+    QMetaObject::invokeMethod(worker, [worker, policy]() {
+        worker->setPolicy(policy);
+    }, Qt::QueuedConnection);
+}
+
+void MainWindow::applyUploadRate() {
+    auto *worker = qobject_cast<UploadWorker*>(uploadSink);
+    if (!worker) return;
+
+    const int kbps = SettingDialog::getUploadRateKbps();
+    const bool yieldToCapture = SettingDialog::getUploadYield();
+    QMetaObject::invokeMethod(worker, [worker, kbps, yieldToCapture]() {
+        worker->setRateLimit(kbps, yieldToCapture);
+    }, Qt::QueuedConnection);
+}
+
+void MainWindow::exportMetrics() {
+    StallScope scope(Q_FUNC_INFO);
+    Metrics::writePrometheus(QCoreApplication::applicationDirPath() + "/metrics.prom");
+    qDebug() << "METRICS: upload" << qint64(Metrics::value("upload_bytes_total")) / 1024 << "KB,"
+             << "throttled" << qint64(Metrics::value("upload_throttled_ms_total")) << "ms,"
+             << "capture bursts" << qint64(Metrics::value("capture_bursts_total"));
+}
+
+void MainWindow::finishStartup() {
+    StallScope scope(Q_FUNC_INFO);
+    loadFonts();
+
+    metricsTimer = new QTimer(this);
+    connect(metricsTimer, &QTimer::timeout, this, &MainWindow::exportMetrics);
+    metricsTimer->start(60 * 1000);
+
+    openSpool();
     configureScanner();
+    StartupProfiler::mark("scanner configured - READY TO SCAN");
+}
+
+void MainWindow::loadFonts() {
+    // Rejestracja TTF z zasobów blokowała start przed pokazaniem okna - teraz po nim
+    if(QFontDatabase::addApplicationFont(":/fonts/Roboto-Regular.ttf") == -1)
+        qWarning() << "Failed to load Roboto-Regular.ttf";
+    if(QFontDatabase::addApplicationFont(":/fonts/RobotoCondensed-Bold.ttf") == -1)
+        qWarning() << "Failed to load RobotoCondensed-Bold.ttf";
+
+    QApplication::setFont(QFont("Roboto", 10));
+    // Arkusz stylów rozwiązuje font-family przy polerowaniu - ponownie, z nowymi czcionkami
+    setStyleSheet(styleSheet());
+    StartupProfiler::mark("fonts");
 }
 
 MainWindow::~MainWindow() {
+    captureThread->quit();
+    captureThread->wait();
     uploadThread->quit();
     uploadThread->wait();
     if(serialScanner->isOpen()) serialScanner->close();
 }
 
+void MainWindow::openSpool() {
+    if (!SettingDialog::getSpoolEnabled() || ImageSpool::instance().isOpen()) return;
+
+    if (!ImageSpool::instance().open(QDir("spool").absoluteFilePath("images.spool"),
+                                     qint64(SettingDialog::getSpoolSizeMb()) * 1024 * 1024)) {
+        qCritical() << "SPOOL: unavailable, images go to tmp/";
+        return;
+    }
+
+    // Niewysłane zdjęcia ze spoola (poprzednie uruchomienie) wracają do kolejki
+    requeueSpoolRecords(ImageSpool::instance().takeRecovered());
+
+    // Nieudane wysyłki trzymają segment - ponawiamy co minutę
+    spoolRetryTimer = new QTimer(this);
+    connect(spoolRetryTimer, &QTimer::timeout, this, &MainWindow::retryFailedUploads);
+    spoolRetryTimer->start(60 * 1000);
+}
+
+void MainWindow::retryFailedUploads() {
+    requeueSpoolRecords(ImageSpool::instance().takeFailed());
+}
+
+void MainWindow::requeueSpoolRecords(const QList<ImageSpool::Record> &records) {
+    for (const ImageSpool::Record &record : records) {
+        // Skan spekulatywny przerwany przed terminatorem - zdjęcie bez palety
+        if (record.palletCode.isEmpty()) {
+            ImageSpool::instance().discard(record.location);
+            continue;
+        }
+        UploadJob job;
+        job.filePath = record.location;
+        job.palletCode = record.palletCode;
+        job.camIndex = record.camIndex;
+        job.capturedAt = record.capturedAt;
+        job.deadline = job.capturedAt.addSecs(SettingDialog::getUploadDeadline());
+        job.retry = true;
+        emit requestUpload(job);
+    }
+}
+
 void MainWindow::ensureTmpFolderExists() {
     QDir dir("tmp");
     if (!dir.exists()) dir.mkpath(".");
@@ -244,6 +659,8 @@ void MainWindow::setupStyles() {
         QWidget#centralOverlay { border-image: url(:/img/bg.png) 0 0 0 0 stretch stretch; }
         QWidget#mainPanel { background-color: white; border-radius: 0px; }
         QLabel#headerTitle { font-family: 'Roboto Condensed'; font-size: 34px; font-weight: 700; color: #001122; letter-spacing: 1px; }
+        QLabel#queueLabel { font-family: 'Roboto'; font-size: 18px; font-weight: 600; color: #666; margin-right: 20px; }
+        QLabel#queueLabel[backlog="true"] { color: #d32f2f; }
         QLabel#dateLabel { font-family: 'Roboto'; font-size: 26px; font-weight: 600; color: #444; margin-right: 20px; }
         QLabel.cameraDisplay { background-color: #222; border: 2px solid #ccc; color: #888; font-weight: bold; }
     )");
@@ -283,6 +700,9 @@ void MainWindow::setupUi() {
     headerTitle->setObjectName("headerTitle");
     headerTitle->setAlignment(Qt::AlignCenter);
 
+    queueLabel = new QLabel(this);
+    queueLabel->setObjectName("queueLabel");
+
     dateLabel = new QLabel(this);
     dateLabel->setObjectName("dateLabel");
     clockTimer = new QTimer(this);
@@ -291,6 +711,7 @@ void MainWindow::setupUi() {
 
     headerLayout->addWidget(logoLabel); headerLayout->addStretch();
     headerLayout->addWidget(headerTitle); headerLayout->addStretch();
+    headerLayout->addWidget(queueLabel);
     headerLayout->addWidget(dateLabel);
 
     cam1_TopLeft = createCameraLabel("Kamera 1"); cam4_TopRight = createCameraLabel("Kamera 4");
@@ -308,144 +729,294 @@ void MainWindow::setupUi() {
 
 void MainWindow::updateClock() {
     dateLabel->setText(QDateTime::currentDateTime().toString("HH:mm:ss"));
+    updateQueueLabel();
 }
 
-void MainWindow::drawStatusOnImage(int camIndex, const QString &filePath, int status, const QString &msg) {
-    if (camIndex < 0 || camIndex >= camDisplays.size()) return;
-    QPixmap pix(filePath);
-    if (pix.isNull()) return;
-
-    QPainter painter(&pix);
-    painter.setRenderHint(QPainter::Antialiasing);
-
-    if (status > 0) {
-        QColor color;
-        QString text = msg;
-        if (status == 1) { color = QColor(0, 120, 215); if(text.isEmpty()) text="WYSYŁANIE..."; }
-        else if (status == 2) { color = QColor(40, 167, 69); if(text.isEmpty()) text="WYSŁANO \u2714"; }
-        else { color = QColor(220, 53, 69); if(text.isEmpty()) text="BŁĄD \u274C"; }
-
-        int w = pix.width();
-        int h = pix.height();
-        int barHeight = qMax(30, h/12);
-
-        painter.fillRect(QRect(0, 0, w, barHeight), color);
+void MainWindow::onUploadQueueStats(int depth, const QDateTime &oldestEnqueued) {
+    uploadQueueDepth = depth;
+    uploadQueueOldest = oldestEnqueued;
+    updateQueueLabel();
+}
 
-        painter.setPen(Qt::white);
-        QFont font = painter.font();
-        font.setPixelSize(barHeight * 0.7);
-        font.setBold(true);
-        painter.setFont(font);
+void MainWindow::updateQueueLabel() {
+    if (uploadQueueDepth == 0 || !uploadQueueOldest.isValid()) {
+        queueLabel->setText(uploadQueueDepth > 0 ? QString("KOLEJKA: %1").arg(uploadQueueDepth) : "");
+        return;
+    }
 
-        painter.drawText(QRect(0, 0, w, barHeight), Qt::AlignCenter, text);
+    const qint64 ageSec = uploadQueueOldest.secsTo(QDateTime::currentDateTime());
+    const QString age = ageSec < 60 ? QString("%1 s").arg(ageSec)
+                      : ageSec < 3600 ? QString("%1 min").arg(ageSec / 60)
+                      : QString("%1 h %2 min").arg(ageSec / 3600).arg((ageSec % 3600) / 60);
+    queueLabel->setText(QString("KOLEJKA: %1 (najstarsze %2)").arg(uploadQueueDepth).arg(age));
+
+    // Czerwony, gdy najstarsze zdjęcie przekroczyło termin wysyłki
+    const bool backlog = ageSec > SettingDialog::getUploadDeadline();
+    if (queueLabel->property("backlog").toBool() != backlog) {
+        queueLabel->setProperty("backlog", backlog);
+        queueLabel->style()->unpolish(queueLabel);
+        queueLabel->style()->polish(queueLabel);
     }
-    painter.end();
+}
 
+void MainWindow::drawStatusOnImage(int camIndex, const QString &filePath, int status, const QString &msg) {
+    StallScope scope(Q_FUNC_INFO);
+    if (camIndex < 0 || camIndex >= camDisplays.size()) return;
     QLabel *lbl = camDisplays[camIndex];
-    if (!lbl->size().isEmpty()) {
-        lbl->setPixmap(pix.scaled(lbl->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
+    if (lbl->size().isEmpty()) return;
+
+    // Nowe zdjęcie dekodujemy od razu w rozmiarze etykiety (JPEG: skalowanie DCT),
+    // kolejne statusy rysujemy na kopii tego podglądu zamiast pełnej klatki z dysku
+    if (status == 0 || cameraPreviews[camIndex].isNull()) {
+        std::unique_ptr<QIODevice> device(ImageSpool::openDevice(filePath));
+        if (!device) return;
+        QImageReader reader(device.get());
+        const QSize fullSize = reader.size();
+        if (fullSize.isValid()) reader.setScaledSize(fullSize.scaled(lbl->size(), Qt::KeepAspectRatio));
+        QImage preview = reader.read();
+        // AVIF / JPEG XL bez wtyczki Qt - dekodujemy przez OpenCV
+        if (preview.isNull()) preview = ImageEncoder::decodeScaled(ImageSpool::load(filePath), lbl->size());
+        if (preview.isNull()) return;
+        cameraPreviews[camIndex] = QPixmap::fromImage(std::move(preview));
     }
+
+    QPixmap pix = cameraPreviews[camIndex];
+    StatusOverlay::paint(&pix, status, msg);
+
+    lbl->setPixmap(pix);
 }
 
 void MainWindow::startScanProcess() {
+    StallScope scope(Q_FUNC_INFO);
     qDebug() << "SCAN: Code -> " << currentPalletCode;
     headerTitle->setText("PALETA: " + currentPalletCode);
 
-    QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmm");
-    QString user = settingsDialog->getGlobalUser();
-    QString pass = settingsDialog->getGlobalPass();
-    QString urlTemplate = settingsDialog->getUrlTemplate();
-    int mode = settingsDialog->getProtocolMode();
+    const QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmm");
+    const QList<int> cameras = submitCaptures(currentPalletCode, timestamp, 0);
+    for (int i : cameras) camDisplays[i]->setText("POBIERANIE...");
+}
 
+QList<int> MainWindow::submitCaptures(const QString &palletCode, const QString &timestamp, quint64 scanId) {
+    QString user = SettingDialog::getGlobalUser();
+    QString pass = SettingDialog::getGlobalPass();
+    const int hedgePercent = SettingDialog::getHedgePercent();
+    const ImageEncoder::Settings encoder = ImageEncoder::effective(SettingDialog::getEncoderSettings());
+
+    QList<int> cameras;
     for(int i=0; i<5; i++) {
-        QString ip = settingsDialog->getCameraIp(i);
-        if (ip.trimmed().isEmpty() || ip == "0") continue;
+        QString ip = SettingDialog::getCameraIp(i);
+        int source = SettingDialog::getCameraSource(i);
+
+        // Ctrl+4: zdjęcie testowe podaje źródło plikowe w potoku (bez pobierania z kamery)
+        if (staticOverrides.contains(i)) {
+            source = CameraSource::File;
+            ip = staticOverrides[i];
+        }
 
-        QString url = urlTemplate;
+        const bool replayed = replayLayer && replayLayer->hasCamera(i);
+        const bool local = source == CameraSource::File || source == CameraSource::Synthetic;
+        if (!local && (ip.trimmed().isEmpty() || ip == "0") && !replayed) continue;
+        if (source == CameraSource::File && ip.trimmed().isEmpty()) continue;
+
+        // Szablon protokołu tej kamery - nie globalnego
+        QString url = SettingDialog::getUrlTemplate(source == CameraSource::Rtsp ? 1 : 0);
         url.replace("%1", user);
         url.replace("%2", pass);
         url.replace("%3", ip);
 
-        QString filename = QString("%1_%2_%3.jpg").arg(currentPalletCode).arg(timestamp).arg(i);
-        QString savePath = QDir("tmp").filePath(filename);
-        int rotation = settingsDialog->getCameraRotation(i);
+        // Skan spekulatywny: nazwa tymczasowa, docelowa po dowiązaniu kodu palety
+        QString filename = scanId != 0
+            ? QString("spec%1_%2%3").arg(scanId).arg(i).arg(ImageEncoder::extension(encoder.format))
+            : QString("%1_%2_%3%4").arg(palletCode).arg(timestamp).arg(i).arg(ImageEncoder::extension(encoder.format));
+
+        CaptureRequest req;
+        req.camIndex = i;
+        req.url = source == CameraSource::File ? ip.trimmed() : url;
+        req.source = source;
+        req.rotation = SettingDialog::getCameraRotation(i);
+        req.roi = SettingDialog::getCameraRoi(i);
+        req.user = user;
+        req.pass = pass;
+        req.savePath = QDir("tmp").filePath(filename);
+        req.palletCode = palletCode;
+        req.spool = SettingDialog::getSpoolEnabled() && ImageSpool::instance().isOpen();
+        req.hedgePercent = hedgePercent;
+        req.encoder = encoder;
+        req.scanId = scanId;
+
+        cameras.append(i);
+        emit requestCapture(req);
+    }
+    return cameras;
+}
+
+void MainWindow::onCameraFinished(int index, bool success, const QString &filePath, const QString &errorMsg, quint64 scanId) {
+    StallScope scope(Q_FUNC_INFO);
+    const CameraResult result{ index, success, filePath, errorMsg };
+    if (scanId != 0) onSpeculativeResult(scanId, result);
+    else publishCameraResult(result, currentPalletCode);
+}
+
+void MainWindow::publishCameraResult(const CameraResult &result, const QString &palletCode) {
+    const int index = result.camIndex;
+    if (result.success) {
+        lastImagePaths[index] = result.location;
 
-        camDisplays[i]->setText("POBIERANIE...");
+        drawStatusOnImage(index, result.location, 0);
 
-        CameraWorker *worker = new CameraWorker(i, url, mode, rotation, user, pass, savePath);
-        connect(worker, &CameraWorker::resultReady, this, &MainWindow::onCameraFinished);
+        UploadJob job;
+        job.filePath = result.location;
+        job.palletCode = palletCode;
+        job.camIndex = index;
+        job.capturedAt = QDateTime::currentDateTime();
+        job.deadline = job.capturedAt.addSecs(SettingDialog::getUploadDeadline());
+
+        emit requestUpload(job);
 
-        cameraPool->start(worker);
+    } else {
+        qWarning() << "MAIN: Cam" << index << "Failed:" << result.errorMsg;
+        camDisplays[index]->setText("BŁĄD:\n" + result.errorMsg);
     }
 }
 
-void MainWindow::onCameraFinished(int index, bool success, const QString &filePath, const QString &errorMsg) {
-    QString finalPath = filePath;
-    bool finalSuccess = success;
-    QString finalMsg = errorMsg;
-
-    // --- TRYB TESTOWY (CTRL+4) ---
-    // Jeśli dla tej kamery ustawiono statyczne zdjęcie, ignorujemy wynik z wątku
-    // i "udajemy", że kamera pobrała to zdjęcie testowe.
-    if (staticOverrides.contains(index)) {
-        QString sourcePath = staticOverrides[index];
-        QImage testImg(sourcePath);
+// =========================================================
+// SPECULATIVE CAPTURE (kamery od pierwszego znaku kodu)
+// =========================================================
+void MainWindow::onScanStarted() {
+    if (!SettingDialog::getSpeculativeCapture()) return;
+    if (openSpeculativeScan != 0) discardSpeculativeScan();
+
+    // Etykiety kamer bez zmian do terminatora - szum nie miga na ekranie
+    const quint64 scanId = nextScanId++;
+    SpeculativeScan scan;
+    scan.timestamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmm");
+    scan.started.start();
+    scan.cameras = submitCaptures(QString(), scan.timestamp, scanId);
+    scan.outstanding = int(scan.cameras.size());
+    if (scan.cameras.isEmpty()) return;
+
+    speculativeScans.insert(scanId, scan);
+    openSpeculativeScan = scanId;
+    speculativeTimer->start();
+    Metrics::add("speculative_scans_started_total", 1);
+}
 
-        if (!testImg.isNull()) {
-            QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd-HHmm");
-            QString stdName = QString("%1_%2_%3.jpg")
-                              .arg(currentPalletCode)
-                              .arg(timestamp)
-                              .arg(index);
+void MainWindow::onCodeScanned(const QString &code) {
+    if (code.isEmpty()) {
+        discardSpeculativeScan();
+        return;
+    }
+    currentPalletCode = code;
+    if (!bindSpeculativeScan(code)) startScanProcess();
+}
 
-            QString exeDir = QCoreApplication::applicationDirPath();
-            QString tmpPath = exeDir + "/tmp/" + stdName;
+bool MainWindow::bindSpeculativeScan(const QString &code) {
+    if (openSpeculativeScan == 0) return false;
+    auto it = speculativeScans.find(openSpeculativeScan);
+    openSpeculativeScan = 0;
+    speculativeTimer->stop();
+    if (it == speculativeScans.end()) return false;
+
+    SpeculativeScan &scan = *it;
+    scan.palletCode = code;
+    scan.bound = true;
+    qDebug() << "SCAN: Code -> " << code << "(speculative, lead" << scan.started.elapsed() << "ms)";
+    Metrics::add("speculative_scans_bound_total", 1);
+    Metrics::add("speculative_lead_ms_total", double(scan.started.elapsed()));
+    headerTitle->setText("PALETA: " + code);
+
+    const QList<CameraResult> parked = std::move(scan.parked);
+    scan.parked.clear();
+    for (int i : scan.cameras) camDisplays[i]->setText("POBIERANIE...");
+    for (const CameraResult &result : parked) {
+        CameraResult bound = result;
+        if (bound.success) bound.location = bindSpeculativeImage(scan, bound.camIndex, bound.location);
+        publishCameraResult(bound, code);
+    }
 
-            if (testImg.save(tmpPath, "JPG", 90)) {
-                qDebug() << "TEST OVERRIDE: Cam" << index << "simulated. Saved to:" << tmpPath;
+    if (scan.outstanding == 0) speculativeScans.erase(it);
+    return true;
+}
 
-                finalPath = tmpPath;
-                finalSuccess = true;
-                finalMsg = "TEST DATA";
-            } else {
-                qCritical() << "TEST OVERRIDE: Failed to save test file to tmp!";
-            }
-        } else {
-            qWarning() << "TEST OVERRIDE: Source file invalid or missing:" << sourcePath;
-        }
+void MainWindow::onSpeculativeResult(quint64 scanId, const CameraResult &result) {
+    auto it = speculativeScans.find(scanId);
+    if (it == speculativeScans.end()) {
+        if (result.success) dropSpeculativeImage(result.location);
+        return;
     }
 
-    if (finalSuccess) {
-        lastImagePaths[index] = finalPath;
+    SpeculativeScan &scan = *it;
+    scan.outstanding--;
+    if (scan.discarded) {
+        if (result.success) dropSpeculativeImage(result.location);
+    } else if (!scan.bound) {
+        scan.parked.append(result);
+    } else {
+        CameraResult bound = result;
+        if (bound.success) bound.location = bindSpeculativeImage(scan, bound.camIndex, bound.location);
+        publishCameraResult(bound, scan.palletCode);
+    }
 
-        drawStatusOnImage(index, finalPath, 0);
+    if (scan.outstanding == 0 && (scan.bound || scan.discarded)) speculativeScans.erase(it);
+}
 
-        UploadJob job;
-        job.filePath = finalPath;
-        job.palletCode = currentPalletCode;
-        job.camIndex = index;
+void MainWindow::discardSpeculativeScan() {
+    if (openSpeculativeScan == 0) return;
+    auto it = speculativeScans.find(openSpeculativeScan);
+    openSpeculativeScan = 0;
+    speculativeTimer->stop();
+    if (it == speculativeScans.end()) return;
+
+    // Zdjęcia, które już są, idą do kosza; spóźnione usuwa onSpeculativeResult
+    qDebug() << "SCAN: Speculative capture discarded (noise)";
+    Metrics::add("speculative_scans_discarded_total", 1);
+    for (const CameraResult &result : it->parked) {
+        if (result.success) dropSpeculativeImage(result.location);
+    }
+    it->parked.clear();
+    it->discarded = true;
+    if (it->outstanding == 0) speculativeScans.erase(it);
+}
 
-        emit requestUpload(job);
+QString MainWindow::bindSpeculativeImage(const SpeculativeScan &scan, int camIndex, const QString &location) {
+    // Rekord spoola: kod palety w nagłówku, nazwę do wysyłki składa ImageSpool::fileName
+    if (ImageSpool::isSpoolLocation(location)) {
+        ImageSpool::instance().relabel(location, scan.palletCode);
+        return location;
+    }
 
-    } else {
-        qWarning() << "MAIN: Cam" << index << "Failed:" << finalMsg;
-        camDisplays[index]->setText("BŁĄD:\n" + finalMsg);
+    // Plik w tmp/: ta sama nazwa co przy zwykłym skanie (zdjęcie z tej minuty jest nadpisywane jak dotąd)
+    const QString target = QDir("tmp").filePath(QString("%1_%2_%3.%4")
+        .arg(scan.palletCode, scan.timestamp).arg(camIndex).arg(QFileInfo(location).suffix()));
+    QFile::remove(target);
+    if (!QFile::rename(location, target)) {
+        qWarning() << "SCAN: Cannot rename" << location << "->" << target;
+        return location;
     }
+    return target;
+}
+
+void MainWindow::dropSpeculativeImage(const QString &location) {
+    if (ImageSpool::isSpoolLocation(location)) ImageSpool::instance().discard(location);
+    else QFile::remove(location);
 }
 
 void MainWindow::onWorkerUploadStarted(int camIndex) {
+    StallScope scope(Q_FUNC_INFO);
     if (!lastImagePaths[camIndex].isEmpty()) {
         drawStatusOnImage(camIndex, lastImagePaths[camIndex], 1);
     }
 }
 
 void MainWindow::onWorkerUploadFinished(int camIndex, bool success, const QString &message) {
+    StallScope scope(Q_FUNC_INFO);
     if (!lastImagePaths[camIndex].isEmpty()) {
         drawStatusOnImage(camIndex, lastImagePaths[camIndex], success ? 2 : 3);
     }
 }
 
 void MainWindow::openTestImageDialog() {
+    StallScope scope(Q_FUNC_INFO);
     bool wasFullScreen = this->isFullScreen();
     if(wasFullScreen) this->showNormal();
 
@@ -474,46 +1045,64 @@ void MainWindow::openTestImageDialog() {
 }
 
 void MainWindow::handleSerialScan() {
-    QByteArray data = serialScanner->readAll();
+    StallScope scope(Q_FUNC_INFO);
+    const QByteArray data = serialScanner->readAll();
+    ScanTraceRecorder::instance().recordInput(ScanTrace::SourceSerial, 0, data);
+    processSerialData(data);
+}
+
+void MainWindow::processSerialData(const QByteArray &data) {
+    const bool firstChunk = serialBuffer.isEmpty();
     serialBuffer.append(data);
     if(serialBuffer.contains('\r') || serialBuffer.contains('\n')) {
         QString code = QString::fromUtf8(serialBuffer).trimmed();
         serialBuffer.clear();
-        if(!code.isEmpty()) {
-            currentPalletCode = code;
-            startScanProcess();
-        }
+        if(!code.isEmpty()) ScanTraceRecorder::instance().recordScan(ScanTrace::SourceSerial, code);
+        onCodeScanned(code);
+    } else if (firstChunk) {
+        onScanStarted();
+    } else if (openSpeculativeScan != 0) {
+        speculativeTimer->start(); // Okno liczone od ostatniego znaku
     }
 }
 
 void MainWindow::keyPressEvent(QKeyEvent *event) {
-    static QString keyBuffer;
-    if(settingsDialog->getSelectedScannerPort() == "KEYBOARD") {
-        if(event->key() == Qt::Key_Return || event->key() == Qt::Key_Enter) {
-            if(!keyBuffer.isEmpty()) {
-                currentPalletCode = keyBuffer;
-                startScanProcess();
-                keyBuffer.clear();
-            }
-        } else {
-            if(!event->text().isEmpty() && event->text().at(0).isPrint()) {
-                keyBuffer.append(event->text());
-            }
-        }
+    StallScope scope(Q_FUNC_INFO);
+    if(SettingDialog::getSelectedScannerPort() == "KEYBOARD") {
+        ScanTraceRecorder::instance().recordInput(ScanTrace::SourceKeyboard, event->key(), event->text().toUtf8());
+        processKey(event->key(), event->text());
     }
     QMainWindow::keyPressEvent(event);
 }
 
+void MainWindow::processKey(int key, const QString &text) {
+    if(key == Qt::Key_Return || key == Qt::Key_Enter) {
+        if(!keyBuffer.isEmpty()) {
+            ScanTraceRecorder::instance().recordScan(ScanTrace::SourceKeyboard, keyBuffer);
+            const QString code = keyBuffer;
+            keyBuffer.clear();
+            onCodeScanned(code);
+        }
+    } else {
+        if(!text.isEmpty() && text.at(0).isPrint()) {
+            if (keyBuffer.isEmpty()) onScanStarted();
+            else if (openSpeculativeScan != 0) speculativeTimer->start(); // Okno liczone od ostatniego znaku
+            keyBuffer.append(text);
+        }
+    }
+}
+
 void MainWindow::configureScanner() {
+    StallScope scope(Q_FUNC_INFO);
     if(serialScanner->isOpen()) serialScanner->close();
-    QString portName = settingsDialog->getSelectedScannerPort();
+    QString portName = SettingDialog::getSelectedScannerPort();
 
     if(portName == "KEYBOARD") headerTitle->setText("ZESKANUJ KOD PALETY");
     else {
         serialScanner->setPortName(portName);
         serialScanner->setBaudRate(QSerialPort::Baud9600);
         if(serialScanner->open(QIODevice::ReadOnly)) {
-            connect(serialScanner, &QSerialPort::readyRead, this, &MainWindow::handleSerialScan);
+            connect(serialScanner, &QSerialPort::readyRead, this, &MainWindow::handleSerialScan, Qt::UniqueConnection);
             headerTitle->setText("GOTOWY (" + portName + ")");
         } else {
             headerTitle->setText("BŁĄD SKANERA");
@@ -521,31 +1110,58 @@ void MainWindow::configureScanner() {
     }
 }
 
+void MainWindow::applyWindowMode() {
+    if (SettingDialog::isFullScreen()) {
+        if (!(windowFlags() & Qt::FramelessWindowHint))
+            this->setWindowFlags(Qt::Window | Qt::FramelessWindowHint);
+        this->showFullScreen();
+    } else {
+        if (windowFlags() & Qt::FramelessWindowHint)
+            this->setWindowFlags(Qt::Window);
+        this->showNormal();
+        this->resize(SettingDialog::getAppWidth(), SettingDialog::getAppHeight());
+    }
+}
+
 void MainWindow::openSettings() {
+    StallScope scope(Q_FUNC_INFO);
     bool wasFullScreen = this->isFullScreen();
     if(wasFullScreen) this->showNormal();
 
-    if(settingsDialog->exec() == QDialog::Accepted) {
-        disconnect(uploadThread, &QThread::finished, uploadWorker, &QObject::deleteLater);
+    if (!settingsDialog) settingsDialog = new SettingDialog(this);
 
-        if(uploadThread->isRunning()) {
-            uploadThread->quit();
-            uploadThread->wait();
-        }
-        delete uploadWorker;
+    const QString oldPort = SettingDialog::getSelectedScannerPort();
 
-        uploadWorker = new UploadWorker(settingsDialog->getServerUrl(), settingsDialog->getUploadTimeout());
-        uploadWorker->moveToThread(uploadThread);
+    if(settingsDialog->exec() == QDialog::Accepted) {
+        // Kolejka uploadu i trwające transfery zostają - nowa konfiguracja tylko dla nowych żądań
+        if (auto *worker = qobject_cast<UploadWorker*>(uploadSink)) {
+            const QStringList serverUrls = SettingDialog::getServerUrls();
+            const int timeout = SettingDialog::getUploadTimeout();
+            QMetaObject::invokeMethod(worker, [worker, serverUrls, timeout]() {
+                worker->updateConfig(serverUrls, timeout);
+            }, Qt::QueuedConnection);
+        } else if (auto *pg = qobject_cast<PgUploadSink*>(uploadSink)) {
+            const QString connInfo = SettingDialog::getPgConnInfo();
+            const bool storeImages = SettingDialog::getPgStoreImages();
+            QMetaObject::invokeMethod(pg, [pg, connInfo, storeImages]() {
+                pg->updateConfig(connInfo, storeImages);
+            }, Qt::QueuedConnection);
+        }
+        applyUploadPolicy();
+        applyUploadRate();
+        if (SettingDialog::getUploadSink() != uploadSinkType) {
+            QMessageBox::information(this, "Odbiorca danych",
+                                     "Zmiana odbiorcy danych (HTTP / PostgreSQL) zadziała po restarcie aplikacji.");
+        }
 
-        connect(uploadThread, &QThread::finished, uploadWorker, &QObject::deleteLater);
-        connect(this, &MainWindow::requestUpload, uploadWorker, &UploadWorker::addJob);
-        connect(uploadWorker, &UploadWorker::uploadStarted, this, &MainWindow::onWorkerUploadStarted);
-        connect(uploadWorker, &UploadWorker::uploadFinished, this, &MainWindow::onWorkerUploadFinished);
+        // Kamery czytają konfigurację przy każdym skanie - nic do restartowania
+        MemoryBudget::global().setLimit(qint64(SettingDialog::getMemoryBudgetMb()) * 1024 * 1024);
+        openSpool();
+        if (SettingDialog::getSelectedScannerPort() != oldPort) configureScanner();
 
-        uploadThread->start();
-        configureScanner();
+        applyWindowMode();
+        return;
     }
 
     if(wasFullScreen) this->showFullScreen();
 }
-
@@ -9,61 +9,90 @@
 #include <opencv2/opencv.hpp>
 #include <QtNetwork>
 #include <QQueue>
-#include <QThreadPool>
-#include <QRunnable>
 #include <QMutex>
 #include <QMap>
+#include <QHash>
+#include <QElapsedTimer>
 #include "SettingDialog.h"
-
-struct UploadJob {
-    QString filePath;
-    QString palletCode;
-    int camIndex;
-};
-
-// --- CAMERA WORKER (Pobiera zdjęcie w tle) ---
-class CameraWorker : public QObject, public QRunnable {
-    Q_OBJECT
-public:
-    CameraWorker(int index, QString url, int protocolMode, int rotation,
-                 QString user, QString pass, QString savePath, QObject *parent = nullptr);
-    void run() override;
-
-signals:
-    void resultReady(int index, bool success, const QString &filePath, const QString &errorMsg);
-
-private:
-    int m_index;
-    QString m_url;
-    int m_protocol;
-    int m_rotation;
-    QString m_user;
-    QString m_pass;
-    QString m_savePath;
+#include "UploadSink.h"
+#include "CapturePipeline.h"
+#include "ImageSpool.h"
+#include "ScanTrace.h"
+#include "RateLimiter.h"
+
+// Co robić z zaległymi zdjęciami (po terminie), gdy kolejka się zapcha
+struct UploadPolicy {
+    enum Backlog { BacklogInOrder = 0, BacklogDowngrade = 1, BacklogDeferOffPeak = 2 };
+    int backlog = BacklogInOrder;
+    int offPeakFrom = 22; // Godziny poza szczytem [from, to)
+    int offPeakTo = 6;
 };
 
-// --- UPLOAD WORKER (Kolejka wysyłania) ---
-class UploadWorker : public QObject {
+// --- UPLOAD WORKER (Kolejka wysyłania HTTP) ---
+// Kolejność: 1) bieżąca paleta (FIFO), 2) zaległe w terminie (najbliższy termin),
+// 3) zaległe po terminie - wg polityki: kolejno / zmniejszone / tylko poza szczytem.
+// Serwerów może być kilka: zdjęcie idzie do zdrowego z najmniejszą liczbą wysyłek w toku
+// (ważoną średnim czasem odpowiedzi), błąd sieci/5xx przenosi je na inny serwer.
+// Serwer po kolejnych błędach wypada z puli i wraca po udanym sprawdzeniu zdrowia.
+class UploadWorker : public UploadSink {
     Q_OBJECT
 public:
-    explicit UploadWorker(QString serverUrl, int timeout, QObject *parent = nullptr);
+    explicit UploadWorker(const QStringList &serverUrls, int timeout, QObject *parent = nullptr);
 
 public slots:
-    void addJob(const UploadJob &job); // Poprawiono na const &
+    void addJob(const UploadJob &job) override;
     void processNext();
+    // Zmiana konfiguracji "na żywo" - dotyczy tylko nowych żądań, kolejka zostaje
+    void updateConfig(const QStringList &serverUrls, int timeout);
+    void setPolicy(const UploadPolicy &policy);
+    // kbps = 0 - bez limitu; yield - dławienie na czas pobierania zdjęć z kamer
+    void setRateLimit(int kbps, bool yieldToCapture);
+    void setCaptureActive(bool active);
 
 signals:
-    void uploadStarted(int camIndex);
-    void uploadFinished(int camIndex, bool success, const QString &message); // Poprawiono na const &
+    void queueStatsChanged(int depth, const QDateTime &oldestEnqueued);
 
 private:
-    void sendRequest(const UploadJob &job); // Poprawiono na const &
+    enum JobClass { ClassCurrent = 0, ClassBacklog = 1, ClassExpired = 2 };
+
+    struct Endpoint {
+        QString url;
+        int outstanding = 0;   // Wysyłki w toku
+        double ewmaMs = 0;     // Średni czas wysyłki (EWMA), 0 = brak próbek
+        int failures = 0;      // Kolejne błędy sieci / 5xx / timeout
+        bool healthy = true;
+        bool probing = false;  // Trwa sprawdzenie zdrowia
+    };
+
+    int pickNext(bool &downgrade) const;
+    int pickEndpoint(const QString &avoid) const;
+    Endpoint *findEndpoint(const QString &url);
+    void setEndpoints(const QStringList &urls);
+    void recordEndpointResult(const QString &url, bool ok, qint64 elapsedMs);
+    void checkEndpoints();
+    void publishEndpointStats();
+    JobClass classify(const UploadJob &job, const QDateTime &now) const;
+    bool isOffPeak(const QDateTime &now) const;
+    void sendRequest(UploadJob job, bool downgrade, int endpoint);
+    void onReplyFinished(QNetworkReply *reply, const UploadJob &job, qint64 elapsedMs);
+    void finishJob(const UploadJob &job, bool success, const QString &msg, bool rejected = false); // rejected = bez ponowień
+    void publishStats();
+    void applyRate();
 
     QNetworkAccessManager *manager;
-    QQueue<UploadJob> m_queue;
-    bool m_isUploading;
-    QString m_serverUrl;
+    QTimer *m_deferTimer; // Ponowne sprawdzenie odłożonych zaległych
+    QTimer *m_healthTimer; // Sprawdzanie serwerów wyłączonych z puli
+    QList<UploadJob> m_queue;
+    int m_inFlight;
+    QList<Endpoint> m_endpoints;
     int m_timeout;
+    QString m_currentPallet;
+    UploadPolicy m_policy;
+
+    TokenBucket m_bucket;
+    qint64 m_rateCap;     // B/s, 0 = bez limitu
+    bool m_yieldToCapture;
+    bool m_captureActive;
 };
 
 // --- GŁÓWNE OKNO ---
@@ -74,6 +103,9 @@ public:
     explicit MainWindow(QWidget *parent = nullptr);
     ~MainWindow() override;
 
+    // Test obciążeniowy: skany i odpowiedzi kamer z pliku śladu (speed 0 = max)
+    bool startReplay(const QString &tracePath, double speed);
+
     protected:
     void keyPressEvent(QKeyEvent *event) override;
 
@@ -84,50 +116,111 @@ public:
     void openTestImageDialog(); // <--- NOWY SLOT (Ctrl+4)
     void handleSerialScan();
     void updateClock();
+    void finishStartup();
+    void discardSpeculativeScan(); // Przerwa bez znaków w oknie - wejście to szum
+    void retryFailedUploads(); // Rekordy spoola po nieudanej wysyłce
 
     // Wątki
-    void onCameraFinished(int index, bool success, const QString &filePath, const QString &errorMsg);
+    void onCameraFinished(int index, bool success, const QString &filePath, const QString &errorMsg, quint64 scanId);
     void onWorkerUploadStarted(int camIndex);
     void onWorkerUploadFinished(int camIndex, bool success, const QString &message);
+    void onUploadQueueStats(int depth, const QDateTime &oldestEnqueued);
 
     signals:
         void requestUpload(const UploadJob &job);
+        void requestCapture(const CaptureRequest &req);
 
     private:
+    // Wynik kamery odłożony do czasu, aż skan spekulatywny dostanie kod palety
+    struct CameraResult {
+        int camIndex;
+        bool success;
+        QString location;
+        QString errorMsg;
+    };
+    // Przechwytywanie spekulatywne: kamery ruszają na pierwszy znak kodu,
+    // kod palety dowiązujemy po terminatorze, przy szumie zdjęcia są usuwane
+    struct SpeculativeScan {
+        QString palletCode;      // Pusty do terminatora
+        QString timestamp;       // Do nazw plików - jak w zwykłym skanie
+        QList<int> cameras;
+        int outstanding = 0;     // Kamery, które jeszcze nie odpowiedziały
+        bool bound = false;
+        bool discarded = false;
+        QElapsedTimer started;
+        QList<CameraResult> parked; // Wyniki sprzed terminatora
+    };
+
     void setupUi();
     void setupStyles();
+    void loadFonts(); // Po pokazaniu okna (poza ścieżką startu), z ponownym polerowaniem stylów
     void configureScanner();
+    void applyWindowMode();
+    UploadSink *createUploadSink();
+    void applyUploadPolicy();
+    void updateQueueLabel();
+    void applyUploadRate();
+    void exportMetrics();
     void ensureTmpFolderExists();
+    void openSpool(); // Rozmiar czytany przy pierwszym otwarciu - zmiana wymaga restartu
+    void requeueSpoolRecords(const QList<ImageSpool::Record> &records);
     QLabel* createCameraLabel(const QString &text);
 
     void drawStatusOnImage(int camIndex, const QString &filePath, int status, const QString &msg = "");
 
+    // Kody ze skanera (klawiatura / port szeregowy) - wspólne dla wejścia na żywo i odtwarzania
+    void processSerialData(const QByteArray &data);
+    void processKey(int key, const QString &text);
+    void onScanStarted();
+    void onCodeScanned(const QString &code);
+    QList<int> submitCaptures(const QString &palletCode, const QString &timestamp, quint64 scanId);
+    void publishCameraResult(const CameraResult &result, const QString &palletCode);
+    void onSpeculativeResult(quint64 scanId, const CameraResult &result);
+    bool bindSpeculativeScan(const QString &code);
+    QString bindSpeculativeImage(const SpeculativeScan &scan, int camIndex, const QString &location);
+    void dropSpeculativeImage(const QString &location);
+
     QWidget *centralWidget;
     QWidget *mainPanel;
     QLabel *logoLabel;
     QLabel *headerTitle;
     QLabel *dateLabel;
+    QLabel *queueLabel;
     QLabel *cam1_TopLeft; QLabel *cam4_TopRight; QLabel *cam0_BotLeft; QLabel *cam2_BotMid; QLabel *cam3_BotRight;
     std::vector<QLabel*> camDisplays;
 
-    SettingDialog *settingsDialog;
+    SettingDialog *settingsDialog; // Tworzony leniwie przy pierwszym Ctrl+5
     QShortcut *secretShortcut; // Ctrl+5
     QShortcut *testShortcut;   // <--- NOWY SKRÓT Ctrl+4
     QShortcut *exitShortcut;
     QTimer *clockTimer;
+    QTimer *metricsTimer;
+    QTimer *spoolRetryTimer;
 
     QSerialPort *serialScanner;
     QByteArray serialBuffer;
     QString currentPalletCode;
+    QString keyBuffer;
+
+    QHash<quint64, SpeculativeScan> speculativeScans; // Do ostatniej odpowiedzi kamery
+    quint64 openSpeculativeScan; // Czeka na terminator, 0 = brak
+    quint64 nextScanId;
+    QTimer *speculativeTimer;
 
     QString lastImagePaths[5];
+    QPixmap cameraPreviews[5]; // Podgląd w rozmiarze etykiety, bez statusu
 
-    // Mapa nadpisań: ID Kamery -> Ścieżka do pliku
-    QMap<int, QString> staticOverrides; // <--- NOWA ZMIENNA
+    // Mapa nadpisań (Ctrl+4): ID Kamery -> Ścieżka do pliku, podawana przez FileSource w potoku
+    QMap<int, QString> staticOverrides;
 
-    QThreadPool *cameraPool;
+    QThread *captureThread;
+    CapturePipeline *capturePipeline;
+    std::shared_ptr<ReplayCameraLayer> replayLayer;
     QThread *uploadThread;
-    UploadWorker *uploadWorker;
+    UploadSink *uploadSink;
+    int uploadSinkType; // Typ odbiorcy utworzonego przy starcie (zmiana wymaga restartu)
+    int uploadQueueDepth;
+    QDateTime uploadQueueOldest;
 };
 
 #endif
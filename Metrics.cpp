@@ -0,0 +1,61 @@
+#include "Metrics.h"
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QTextStream>
+
+namespace {
+struct Entry {
+    double value = 0;
+    bool gauge = false;
+};
+
+QMutex &registryMutex() {
+    static QMutex mutex;
+    return mutex;
+}
+
+QMap<QByteArray, Entry> &registry() {
+    static QMap<QByteArray, Entry> entries;
+    return entries;
+}
+}
+
+void Metrics::add(const char *name, double delta) {
+    QMutexLocker lock(&registryMutex());
+    registry()[name].value += delta;
+}
+
+void Metrics::set(const char *name, double value) {
+    QMutexLocker lock(&registryMutex());
+    Entry &e = registry()[name];
+    e.value = value;
+    e.gauge = true;
+}
+
+double Metrics::value(const char *name) {
+    QMutexLocker lock(&registryMutex());
+    return registry().value(name).value;
+}
+
+bool Metrics::writePrometheus(const QString &path) {
+    QMap<QByteArray, Entry> snapshot;
+    {
+        QMutexLocker lock(&registryMutex());
+        snapshot = registry();
+    }
+
+    // QSaveFile - kolektor nigdy nie zobaczy połowy pliku
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+    QTextStream out(&file);
+    for (auto it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+        const QString name = "magazyn_" + QString::fromLatin1(it.key());
+        out << "# TYPE " << name << (it->gauge ? " gauge\n" : " counter\n");
+        out << name << " " << it->value << "\n";
+    }
+    out.flush();
+    return file.commit();
+}
@@ -0,0 +1,18 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+
+// --- METRYKI (liczniki i wskaźniki procesu, bezpieczne wątkowo) ---
+// Eksport w formacie tekstowym Prometheusa (node_exporter textfile collector).
+namespace Metrics {
+
+void add(const char *name, double delta);   // Licznik (rosnący)
+void set(const char *name, double value);   // Wskaźnik (bieżąca wartość)
+double value(const char *name);
+
+bool writePrometheus(const QString &path);
+
+}
+
+#endif
@@ -0,0 +1,270 @@
+#include "PgSink.h"
+#include "ImageSpool.h"
+#include "Metrics.h"
+#include <QCryptographicHash>
+#include <QDebug>
+#include <libpq-fe.h>
+#include <algorithm>
+
+namespace {
+const int kBatchSize = 32;       // Maks. liczba wierszy w jednym pipeline
+const int kFlushDelayMs = 200;   // Ile czekamy na dobranie kolejnych zdjęć do paczki
+const int kRetryDelayMs = 5000;  // Ponowienie po utracie połączenia
+const char *kGate = "2";
+
+const char *kCreateTable = R"(
+    CREATE TABLE IF NOT EXISTS scan_events (
+        id          bigserial PRIMARY KEY,
+        pallet_code text        NOT NULL,
+        gate        integer     NOT NULL,
+        camera      integer     NOT NULL,
+        captured_at timestamptz NOT NULL,
+        stored_at   timestamptz NOT NULL DEFAULT now(),
+        file_name   text,
+        size_bytes  integer     NOT NULL,
+        sha256      bytea       NOT NULL,
+        image       bytea
+    )
+)";
+
+const char *kInsert =
+    "INSERT INTO scan_events (pallet_code, gate, camera, captured_at, file_name, size_bytes, sha256, image) "
+    "VALUES ($1, $2, $3, $4, $5, $6, $7, $8)";
+
+const int kParamFormats[8] = { 0, 0, 0, 0, 0, 0, 1, 1 }; // sha256 i image binarnie
+
+// Bufory parametrów jednego wiersza - muszą żyć do wywołania PQsend*/PQexec*
+struct RowParams {
+    QByteArray code, cam, ts, name, size;
+    const char *values[8];
+    int lengths[8];
+};
+}
+
+static void bindRow(RowParams &p, const UploadJob &job, int size, const QByteArray &sha256,
+                    const QByteArray &image, bool storeImages)
+{
+    p.code = job.palletCode.toUtf8();
+    p.cam = QByteArray::number(job.camIndex);
+    p.ts = job.capturedAt.toUTC().toString(Qt::ISODateWithMs).toUtf8();
+    p.name = ImageSpool::fileName(job.filePath).toUtf8();
+    p.size = QByteArray::number(size);
+
+    const char *values[8] = { p.code.constData(), kGate, p.cam.constData(), p.ts.constData(),
+                              p.name.constData(), p.size.constData(), sha256.constData(),
+                              storeImages ? image.constData() : nullptr };
+    const int lengths[8] = { 0, 0, 0, 0, 0, 0, int(sha256.size()), int(image.size()) };
+    std::copy(values, values + 8, p.values);
+    std::copy(lengths, lengths + 8, p.lengths);
+}
+
+PgUploadSink::PgUploadSink(QString connInfo, bool storeImages, QObject *parent)
+    : UploadSink(parent), m_conn(nullptr), m_connInfo(connInfo), m_storeImages(storeImages)
+{
+    // Dziecko obiektu - przenosi się razem z nim przez moveToThread()
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &PgUploadSink::flush);
+}
+
+PgUploadSink::~PgUploadSink() {
+    disconnectDb();
+}
+
+void PgUploadSink::addJob(const UploadJob &job) {
+    m_pending.append(job);
+    if (m_pending.size() >= kBatchSize) flush();
+    else if (!m_flushTimer->isActive()) m_flushTimer->start(kFlushDelayMs);
+}
+
+void PgUploadSink::updateConfig(const QString &connInfo, bool storeImages) {
+    qDebug() << "PgSink: new config (pending:" << m_pending.size() << ")";
+    if (connInfo != m_connInfo) disconnectDb(); // Nowe połączenie przy następnej paczce
+    m_connInfo = connInfo;
+    m_storeImages = storeImages;
+}
+
+void PgUploadSink::disconnectDb() {
+    if (m_conn) {
+        PQfinish(m_conn);
+        m_conn = nullptr;
+    }
+}
+
+bool PgUploadSink::ensureConnected() {
+    if (m_conn && PQstatus(m_conn) == CONNECTION_OK) return true;
+    if (m_conn) PQreset(m_conn);
+    else m_conn = PQconnectdb(m_connInfo.toUtf8().constData());
+
+    if (PQstatus(m_conn) != CONNECTION_OK) {
+        qCritical() << "PgSink: Connection failed:" << PQerrorMessage(m_conn);
+        disconnectDb();
+        return false;
+    }
+
+    PGresult *res = PQexec(m_conn, kCreateTable);
+    bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+    PQclear(res);
+
+    if (ok) {
+        res = PQprepare(m_conn, "scan_insert", kInsert, 8, nullptr);
+        ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+    }
+
+    if (!ok) {
+        qCritical() << "PgSink: Schema/prepare failed:" << PQerrorMessage(m_conn);
+        disconnectDb();
+        return false;
+    }
+
+    qDebug() << "PgSink: Connected, server version" << PQserverVersion(m_conn);
+    return true;
+}
+
+void PgUploadSink::flush() {
+    m_flushTimer->stop();
+    if (m_pending.isEmpty()) return;
+
+    if (!ensureConnected()) {
+        m_flushTimer->start(kRetryDelayMs);
+        return;
+    }
+
+    QList<UploadJob> batch = m_pending.mid(0, kBatchSize);
+    m_pending.remove(0, batch.size());
+
+    QList<Row> rows;
+    for (const UploadJob &job : batch) {
+        emit uploadStarted(job.camIndex);
+
+        // Rekord spoola: widok na mapowanie, ważny do release() po zapisie w bazie
+        const QByteArray data = ImageSpool::load(job.filePath);
+        if (data.isEmpty()) {
+            qCritical() << "PgSink: File error" << job.filePath;
+            ImageSpool::instance().discard(job.filePath);
+            emit uploadFinished(job.camIndex, false, "File Access Error");
+            continue;
+        }
+
+        Row row;
+        row.job = job;
+        row.size = data.size();
+        row.sha256 = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+        if (m_storeImages) row.image = data;
+        rows.append(row);
+    }
+
+    QList<RowStatus> status;
+    if (!rows.isEmpty() && !insertPipelined(rows, status)) {
+        // Połączenie padło w trakcie - cała paczka wraca na początek kolejki
+        qCritical() << "PgSink: Batch failed, will retry:" << PQerrorMessage(m_conn);
+        disconnectDb();
+        for (int i = rows.size() - 1; i >= 0; --i) m_pending.prepend(rows[i].job);
+        m_flushTimer->start(kRetryDelayMs);
+        return;
+    }
+
+    for (int i = rows.size() - 1; i >= 0; --i) {
+        if (status[i] == RowAborted) m_pending.prepend(rows[i].job);
+    }
+    for (int i = 0; i < rows.size(); ++i) {
+        if (status[i] == RowAborted) continue;
+        const bool stored = status[i] == RowStored;
+        if (stored) qDebug() << "PgSink: Stored Cam" << rows[i].job.camIndex;
+        if (stored) {
+            ImageSpool::instance().release(rows[i].job.filePath, true);
+        } else {
+            // Wiersz odrzucony przez bazę (zerwane połączenie wraca wyżej) - bez ponowień
+            Metrics::add("upload_rejected_total", 1);
+            ImageSpool::instance().discard(rows[i].job.filePath);
+        }
+        emit uploadFinished(rows[i].job.camIndex, stored, stored ? "OK" : "DB Error");
+    }
+
+    if (!m_pending.isEmpty()) m_flushTimer->start(0);
+}
+
+bool PgUploadSink::insertPipelined(const QList<Row> &rows, QList<RowStatus> &status) {
+#ifdef LIBPQ_HAS_PIPELINING
+    if (PQenterPipelineMode(m_conn) != 1) return insertSequential(rows, status);
+
+    for (const Row &row : rows) {
+        // Parametry są kopiowane do bufora wyjściowego libpq - lokalne bufory wystarczą
+        RowParams p;
+        bindRow(p, row.job, row.size, row.sha256, row.image, m_storeImages);
+        if (PQsendQueryPrepared(m_conn, "scan_insert", 8, p.values, p.lengths, kParamFormats, 0) != 1) {
+            PQexitPipelineMode(m_conn);
+            return false;
+        }
+    }
+    if (PQpipelineSync(m_conn) != 1) return false;
+
+    // Każde zapytanie daje jeden wynik zakończony NULL, na końcu PGRES_PIPELINE_SYNC
+    status.clear();
+    bool synced = false;
+    while (!synced) {
+        PGresult *res = PQgetResult(m_conn);
+        if (!res) {
+            if (PQstatus(m_conn) != CONNECTION_OK) return false;
+            continue;
+        }
+        switch (PQresultStatus(res)) {
+        case PGRES_PIPELINE_SYNC:
+            synced = true;
+            break;
+        case PGRES_COMMAND_OK:
+            status.append(RowStored);
+            break;
+        case PGRES_PIPELINE_ABORTED:
+            status.append(RowAborted); // Ofiara wcześniejszego błędu w tej paczce
+            break;
+        default:
+            qCritical() << "PgSink: Insert failed:" << PQresultErrorMessage(res);
+            status.append(RowFailed);
+            break;
+        }
+        PQclear(res);
+    }
+
+    PQexitPipelineMode(m_conn);
+
+    // Zapytania do jednej synchronizacji to niejawna transakcja - błąd wycofuje całą paczkę
+    if (status.contains(RowFailed)) {
+        for (RowStatus &st : status) if (st == RowStored) st = RowAborted;
+    }
+    return status.size() == rows.size();
+#else
+    return insertSequential(rows, status);
+#endif
+}
+
+bool PgUploadSink::insertSequential(const QList<Row> &rows, QList<RowStatus> &status) {
+    // Starsze libpq (< 14) - jedna transakcja, zapytania po kolei
+    PGresult *res = PQexec(m_conn, "BEGIN");
+    bool began = PQresultStatus(res) == PGRES_COMMAND_OK;
+    PQclear(res);
+    if (!began) return false;
+
+    status.clear();
+    for (const Row &row : rows) {
+        RowParams p;
+        bindRow(p, row.job, row.size, row.sha256, row.image, m_storeImages);
+        res = PQexecPrepared(m_conn, "scan_insert", 8, p.values, p.lengths, kParamFormats, 0);
+        const bool stored = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!stored) qCritical() << "PgSink: Insert failed:" << PQresultErrorMessage(res);
+        PQclear(res);
+        status.append(stored ? RowStored : RowFailed);
+        if (!stored) break;
+    }
+
+    // Błąd jednego wiersza wycofuje transakcję - pozostałe idą do ponowienia
+    const bool allOk = status.size() == rows.size() && !status.contains(RowFailed);
+    res = PQexec(m_conn, allOk ? "COMMIT" : "ROLLBACK");
+    PQclear(res);
+    if (!allOk) {
+        for (RowStatus &st : status) if (st == RowStored) st = RowAborted;
+        while (status.size() < rows.size()) status.append(RowAborted);
+    }
+    return PQstatus(m_conn) == CONNECTION_OK;
+}
@@ -0,0 +1,48 @@
+#ifndef PGSINK_H
+#define PGSINK_H
+
+#include <QTimer>
+#include <QList>
+#include "UploadSink.h"
+
+typedef struct pg_conn PGconn;
+
+// --- POSTGRESQL SINK (zapis skanów prosto do bazy, bez PHP) ---
+// Zadania są zbierane w paczki i wysyłane jednym pipeline'em libpq
+// (przygotowane zapytanie, jedna synchronizacja na paczkę).
+class PgUploadSink : public UploadSink {
+    Q_OBJECT
+public:
+    PgUploadSink(QString connInfo, bool storeImages, QObject *parent = nullptr);
+    ~PgUploadSink() override;
+
+public slots:
+    void addJob(const UploadJob &job) override;
+    void updateConfig(const QString &connInfo, bool storeImages);
+
+private slots:
+    void flush();
+
+private:
+    enum RowStatus { RowStored, RowFailed, RowAborted };
+
+    struct Row {
+        UploadJob job;
+        QByteArray sha256;
+        QByteArray image;
+        int size;
+    };
+
+    bool ensureConnected();
+    void disconnectDb();
+    bool insertPipelined(const QList<Row> &rows, QList<RowStatus> &status);
+    bool insertSequential(const QList<Row> &rows, QList<RowStatus> &status);
+
+    PGconn *m_conn;
+    QTimer *m_flushTimer;
+    QList<UploadJob> m_pending;
+    QString m_connInfo;
+    bool m_storeImages;
+};
+
+#endif
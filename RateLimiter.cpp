@@ -0,0 +1,95 @@
+#include "RateLimiter.h"
+#include "Metrics.h"
+#include <QTimer>
+#include <cmath>
+
+namespace {
+const qint64 kMinBurst = 16 * 1024;
+}
+
+// =========================================================
+// TOKEN BUCKET
+// =========================================================
+TokenBucket::TokenBucket() : m_rate(0), m_burst(kMinBurst), m_tokens(0), m_lastNs(0) {
+    m_clock.start();
+}
+
+void TokenBucket::setRate(qint64 bytesPerSec) {
+    refill();
+    m_rate = bytesPerSec;
+    // Pojemność ~250 ms ruchu - krótkie piki bez zalewania łącza
+    m_burst = qMax(kMinBurst, bytesPerSec / 4);
+    m_tokens = qMin(m_tokens, double(m_burst));
+}
+
+void TokenBucket::refill() {
+    const qint64 nowNs = m_clock.nsecsElapsed();
+    if (m_rate > 0) {
+        m_tokens = qMin(double(m_burst), m_tokens + double(nowNs - m_lastNs) * m_rate / 1e9);
+    }
+    m_lastNs = nowNs;
+}
+
+qint64 TokenBucket::take(qint64 wanted) {
+    if (m_rate <= 0) return wanted;
+    refill();
+    const qint64 granted = qMin(wanted, qint64(m_tokens));
+    m_tokens -= double(granted);
+    return granted;
+}
+
+int TokenBucket::msUntilAvailable(qint64 bytes) {
+    if (m_rate <= 0) return 0;
+    refill();
+    const double missing = double(qMin(bytes, m_burst)) - m_tokens;
+    if (missing <= 0) return 0;
+    return qMax(1, int(std::ceil(missing * 1000.0 / double(m_rate))));
+}
+
+// =========================================================
+// THROTTLED UPLOAD DEVICE
+// =========================================================
+ThrottledUploadDevice::ThrottledUploadDevice(const QByteArray &data, TokenBucket *bucket, QObject *parent)
+    : QIODevice(parent), m_data(data), m_pos(0), m_bucket(bucket), m_wakeScheduled(false)
+{
+    open(QIODevice::ReadOnly);
+}
+
+qint64 ThrottledUploadDevice::bytesAvailable() const {
+    return (m_data.size() - m_pos) + QIODevice::bytesAvailable();
+}
+
+bool ThrottledUploadDevice::atEnd() const {
+    return m_pos >= m_data.size() && QIODevice::bytesAvailable() == 0;
+}
+
+qint64 ThrottledUploadDevice::readData(char *data, qint64 maxSize) {
+    const qint64 remaining = m_data.size() - m_pos;
+    if (remaining <= 0) return -1;
+
+    // Małe porcje (~16 KB) - łącze dzielone równo z pobieraniem zdjęć z kamer
+    const qint64 wanted = qMin(qMin(maxSize, remaining), qint64(16 * 1024));
+    const qint64 granted = m_bucket->take(wanted);
+
+    if (granted <= 0) {
+        if (!m_throttled.isValid()) m_throttled.start();
+        if (!m_wakeScheduled) {
+            m_wakeScheduled = true;
+            QTimer::singleShot(m_bucket->msUntilAvailable(wanted), this, [this]() {
+                m_wakeScheduled = false;
+                emit readyRead();
+            });
+        }
+        return 0;
+    }
+
+    if (m_throttled.isValid()) {
+        Metrics::add("upload_throttled_ms_total", double(m_throttled.elapsed()));
+        m_throttled.invalidate();
+    }
+
+    memcpy(data, m_data.constData() + m_pos, size_t(granted));
+    m_pos += granted;
+    Metrics::add("upload_bytes_total", double(granted));
+    return granted;
+}
@@ -0,0 +1,53 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <QIODevice>
+#include <QElapsedTimer>
+#include <QByteArray>
+
+// --- TOKEN BUCKET (limit przepustowości wysyłania) ---
+// Używany tylko z wątku uploadu. Rate 0 = bez limitu.
+class TokenBucket {
+public:
+    TokenBucket();
+
+    void setRate(qint64 bytesPerSec);
+    qint64 rate() const { return m_rate; }
+    qint64 take(qint64 wanted);
+    int msUntilAvailable(qint64 bytes);
+
+private:
+    void refill();
+
+    qint64 m_rate;
+    qint64 m_burst;
+    double m_tokens;
+    QElapsedTimer m_clock;
+    qint64 m_lastNs;
+};
+
+// --- URZĄDZENIE Z DŁAWIENIEM (ciało żądania POST podawane wg tokenów) ---
+// Sekwencyjne: gdy brak tokenów readData() zwraca 0, a readyRead() przychodzi
+// z timera. Czas czekania jest doliczany do metryki upload_throttled_ms_total.
+class ThrottledUploadDevice : public QIODevice {
+    Q_OBJECT
+public:
+    ThrottledUploadDevice(const QByteArray &data, TokenBucket *bucket, QObject *parent = nullptr);
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    bool atEnd() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    QByteArray m_data;
+    qint64 m_pos;
+    TokenBucket *m_bucket;
+    bool m_wakeScheduled;
+    QElapsedTimer m_throttled; // Ważny, gdy czekamy na tokeny
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "ScanTrace.h"
+#include <QMutexLocker>
+#include <QDebug>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+const quint32 kMagic = 0x4D535452; // 'MSTR'
+const quint16 kVersion = 2;
+const quint16 kMinVersion = 1; // Ślady bez surowego wejścia nadal się odtwarzają
+}
+
+// =========================================================
+// RECORDER
+// =========================================================
+ScanTraceRecorder &ScanTraceRecorder::instance() {
+    static ScanTraceRecorder recorder;
+    return recorder;
+}
+
+bool ScanTraceRecorder::open(const QString &path) {
+    QMutexLocker lock(&m_mutex);
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "TRACE: Cannot open" << path << m_file.errorString();
+        return false;
+    }
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_6_0);
+    m_stream << kMagic << kVersion;
+    m_clock.start();
+    qDebug() << "TRACE: Recording to" << path;
+    return true;
+}
+
+bool ScanTraceRecorder::isActive() const {
+    QMutexLocker lock(&m_mutex);
+    return m_file.isOpen();
+}
+
+void ScanTraceRecorder::recordScan(ScanTrace::ScanSource source, const QString &code) {
+    QMutexLocker lock(&m_mutex);
+    if (!m_file.isOpen()) return;
+    m_stream << quint8(ScanTrace::ScanEvent) << qint64(m_clock.nsecsElapsed() / 1000)
+             << quint8(source) << code;
+    m_file.flush(); // Ślad ma przetrwać crash kiosku
+}
+
+void ScanTraceRecorder::recordInput(ScanTrace::ScanSource source, int key, const QByteArray &data) {
+    QMutexLocker lock(&m_mutex);
+    if (!m_file.isOpen()) return;
+    m_stream << quint8(ScanTrace::InputEvent) << qint64(m_clock.nsecsElapsed() / 1000)
+             << quint8(source) << qint32(key) << data;
+}
+
+void ScanTraceRecorder::recordCamera(const ScanTrace::CameraResponse &r) {
+    QMutexLocker lock(&m_mutex);
+    if (!m_file.isOpen()) return;
+    m_stream << quint8(ScanTrace::CameraEvent) << qint64(m_clock.nsecsElapsed() / 1000)
+             << qint8(r.camIndex) << qint64(r.bytes) << qint32(r.latencyMs)
+             << qint32(r.width) << qint32(r.height) << r.error;
+}
+
+// =========================================================
+// REPLAY CAMERA LAYER
+// =========================================================
+ReplayCameraLayer::ReplayCameraLayer(double speed) : m_speed(speed) {}
+
+void ReplayCameraLayer::addResponse(const ScanTrace::CameraResponse &response) {
+    QMutexLocker lock(&m_mutex);
+    m_responses[response.camIndex].append(response);
+}
+
+bool ReplayCameraLayer::hasCamera(int camIndex) const {
+    QMutexLocker lock(&m_mutex);
+    return m_responses.contains(camIndex);
+}
+
+bool ReplayCameraLayer::next(int camIndex, ScanTrace::CameraResponse &out) {
+    QMutexLocker lock(&m_mutex);
+    auto it = m_responses.constFind(camIndex);
+    if (it == m_responses.constEnd() || it->isEmpty()) return false;
+
+    // Po wyczerpaniu nagrania kamera zaczyna od początku
+    int &cursor = m_cursor[camIndex];
+    out = it->at(cursor % it->size());
+    cursor++;
+    return true;
+}
+
+int ReplayCameraLayer::scaledDelay(int latencyMs) const {
+    if (m_speed <= 0) return 0;
+    return int(latencyMs / m_speed);
+}
+
+QByteArray ReplayCameraLayer::payloadFor(int width, int height) {
+    if (width <= 0 || height <= 0) { width = 1920; height = 1080; }
+    const quint64 key = (quint64(width) << 32) | quint64(height);
+
+    QMutexLocker lock(&m_mutex);
+    auto it = m_payloadCache.constFind(key);
+    if (it != m_payloadCache.constEnd()) return *it;
+
+    // Gradient z szumem - rozmiar JPEG zbliżony do zdjęcia z kamery, generowany raz
+    cv::Mat img(height, width, CV_8UC3);
+    cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(64));
+    for (int y = 0; y < height; y += 64)
+        cv::rectangle(img, cv::Rect(0, y, width, 32), cv::Scalar(40, 90 + y % 120, 160), cv::FILLED);
+
+    std::vector<uchar> buf;
+    cv::imencode(".jpg", img, buf, { cv::IMWRITE_JPEG_QUALITY, 85 });
+    QByteArray payload(reinterpret_cast<const char*>(buf.data()), qsizetype(buf.size()));
+    m_payloadCache.insert(key, payload);
+    return payload;
+}
+
+// =========================================================
+// REPLAYER
+// =========================================================
+ScanTraceReplayer::ScanTraceReplayer(QObject *parent)
+    : QObject(parent), m_next(0), m_speed(1.0) {}
+
+bool ScanTraceReplayer::load(const QString &path, double speed) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "REPLAY: Cannot open" << path << file.errorString();
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic; quint16 version;
+    in >> magic >> version;
+    if (magic != kMagic || version < kMinVersion || version > kVersion) {
+        qCritical() << "REPLAY: Not a scan trace:" << path;
+        return false;
+    }
+
+    m_speed = speed;
+    m_layer = std::make_shared<ReplayCameraLayer>(speed);
+    m_scans.clear();
+    QList<ScanEntry> inputs;
+    int cameraEvents = 0;
+
+    while (!in.atEnd()) {
+        quint8 type; qint64 timeUs;
+        in >> type >> timeUs;
+        if (type == ScanTrace::ScanEvent) {
+            quint8 source; QString code;
+            in >> source >> code;
+            m_scans.append({ timeUs, code });
+        } else if (type == ScanTrace::InputEvent) {
+            quint8 source; qint32 key; QByteArray data;
+            in >> source >> key >> data;
+            ScanEntry e;
+            e.timeUs = timeUs;
+            e.input = true;
+            e.source = source;
+            e.key = key;
+            e.data = data;
+            inputs.append(e);
+        } else if (type == ScanTrace::CameraEvent) {
+            qint8 cam; qint64 bytes; qint32 latency, width, height;
+            ScanTrace::CameraResponse r;
+            in >> cam >> bytes >> latency >> width >> height >> r.error;
+            r.camIndex = cam; r.bytes = bytes; r.latencyMs = latency;
+            r.width = width; r.height = height;
+            m_layer->addResponse(r);
+            cameraEvents++;
+        } else {
+            break;
+        }
+        if (in.status() != QDataStream::Ok) break; // Ucięty ostatni rekord (crash przy nagrywaniu)
+    }
+
+    // Kody powstają z wejścia w obsłudze skanera - przy surowym wejściu gotowe kody by je dublowały
+    const int codes = int(m_scans.size());
+    if (!inputs.isEmpty()) m_scans = inputs;
+
+    qDebug() << "REPLAY: Loaded" << codes << "scans," << inputs.size() << "scanner inputs," << cameraEvents
+             << "camera responses, speed" << (speed > 0 ? QString::number(speed) + "x" : QString("max"));
+    return !m_scans.isEmpty();
+}
+
+std::shared_ptr<ReplayCameraLayer> ScanTraceReplayer::cameraLayer() const {
+    return m_layer;
+}
+
+void ScanTraceReplayer::start() {
+    m_next = 0;
+    m_clock.start();
+    scheduleNext();
+}
+
+void ScanTraceReplayer::scheduleNext() {
+    if (m_next >= m_scans.size()) {
+        qDebug() << "REPLAY: Finished" << m_scans.size() << "events in" << m_clock.elapsed() << "ms";
+        emit finished();
+        return;
+    }
+
+    qint64 delayMs = 0;
+    if (m_speed > 0) {
+        const qint64 targetMs = qint64((m_scans[m_next].timeUs - m_scans.first().timeUs) / 1000 / m_speed);
+        delayMs = qMax<qint64>(0, targetMs - m_clock.elapsed());
+    }
+
+    QTimer::singleShot(int(delayMs), this, [this]() {
+        const ScanEntry &e = m_scans[m_next];
+        if (e.input) emit inputReplayed(e.source, e.key, e.data);
+        else emit scanReplayed(e.code);
+        m_next++;
+        scheduleNext();
+    });
+}
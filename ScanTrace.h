@@ -0,0 +1,109 @@
+#ifndef SCANTRACE_H
+#define SCANTRACE_H
+
+#include <QObject>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <memory>
+
+// Format pliku śladu (QDataStream, Qt_6_0):
+//   nagłówek: quint32 magic 'MSTR', quint16 wersja (1 = tylko kody, 2 = + surowe wejście skanera)
+//   rekordy:  quint8 typ, qint64 czas [us od startu nagrywania], pola typu
+//   wejście:  quint8 źródło, qint32 klawisz (0 dla portu), QByteArray bajty / tekst klawisza
+namespace ScanTrace {
+enum EventType : quint8 { ScanEvent = 1, CameraEvent = 2, InputEvent = 3 };
+enum ScanSource : quint8 { SourceSerial = 0, SourceKeyboard = 1 };
+
+struct CameraResponse {
+    int camIndex = 0;
+    qint64 bytes = 0;      // Rozmiar odpowiedzi (HTTP: JPEG, RTSP: surowa klatka)
+    int latencyMs = 0;
+    int width = 0;
+    int height = 0;
+    QString error;         // Pusty = sukces
+};
+}
+
+// --- REJESTRATOR ŚLADU (skany + odpowiedzi kamer, bezpieczny wątkowo) ---
+class ScanTraceRecorder {
+public:
+    static ScanTraceRecorder &instance();
+
+    bool open(const QString &path);
+    bool isActive() const;
+    void recordScan(ScanTrace::ScanSource source, const QString &code);
+    // Surowe wejście: porcja z portu szeregowego albo jeden klawisz (z czasem - podział i tempo)
+    void recordInput(ScanTrace::ScanSource source, int key, const QByteArray &data);
+    void recordCamera(const ScanTrace::CameraResponse &response);
+
+private:
+    ScanTraceRecorder() = default;
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_clock;
+};
+
+// --- WARSTWA UDAWANYCH KAMER (odtwarza nagrane odpowiedzi w potoku) ---
+// Używana z wątku potoku, tworzona przez ScanTraceReplayer.
+class ReplayCameraLayer {
+public:
+    explicit ReplayCameraLayer(double speed);
+
+    void addResponse(const ScanTrace::CameraResponse &response);
+    bool hasCamera(int camIndex) const;
+    bool next(int camIndex, ScanTrace::CameraResponse &out);
+    int scaledDelay(int latencyMs) const;
+    QByteArray payloadFor(int width, int height);
+
+private:
+    mutable QMutex m_mutex;
+    double m_speed; // 0 = bez opóźnień
+    QHash<int, QList<ScanTrace::CameraResponse>> m_responses;
+    QHash<int, int> m_cursor;
+    QHash<quint64, QByteArray> m_payloadCache; // JPEG syntetyczny per rozdzielczość
+};
+
+// --- ODTWARZANIE ŚLADU (1x / 10x / max) ---
+// Ślad z surowym wejściem idzie porcjami/klawiszami przez obsługę skanera (jak na żywo,
+// z przechwytywaniem spekulatywnym); starszy ślad (tylko kody) - gotowymi kodami.
+class ScanTraceReplayer : public QObject {
+    Q_OBJECT
+public:
+    explicit ScanTraceReplayer(QObject *parent = nullptr);
+
+    bool load(const QString &path, double speed);
+    void start();
+    std::shared_ptr<ReplayCameraLayer> cameraLayer() const;
+
+signals:
+    void scanReplayed(const QString &code);
+    void inputReplayed(int source, int key, const QByteArray &data);
+    void finished();
+
+private:
+    void scheduleNext();
+
+    struct ScanEntry {
+        qint64 timeUs;
+        QString code;
+        bool input = false; // Surowe wejście zamiast gotowego kodu
+        int source = 0;
+        int key = 0;
+        QByteArray data;
+    };
+
+    QList<ScanEntry> m_scans;
+    int m_next;
+    double m_speed;
+    QElapsedTimer m_clock;
+    std::shared_ptr<ReplayCameraLayer> m_layer;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "SettingDialog.h"
 #include <QVBoxLayout>
+#include <QHBoxLayout>
 #include <QFormLayout>
 #include <QPushButton>
 #include <QLabel>
@@ -7,22 +8,31 @@
 #include <QCoreApplication>
 #include <QSerialPortInfo>
 #include <QGroupBox>
+#include <QtConcurrent>
+#include <QRegularExpression>
+#include <QMessageBox>
 
-SettingDialog::SettingDialog(QWidget *parent) : QDialog(parent) {
+namespace {
+QStringList splitServerUrls(const QString &urls) {
+    return urls.split(QRegularExpression("[\\s,;]+"), Qt::SkipEmptyParts);
+}
+}
+
+SettingDialog::SettingDialog(QWidget *parent) : QDialog(parent), portWatcher(nullptr) {
     setWindowTitle("Panel Administratora (Ctrl+5)");
     setMinimumSize(750, 650);
     setupUi();
 }
 
-QSettings* SettingDialog::getSettings() {
-    QString configPath = QCoreApplication::applicationDirPath() + "/config.ini";
-    return new QSettings(configPath, QSettings::IniFormat);
+QSettings &SettingDialog::getSettings() {
+    static QSettings settings(QCoreApplication::applicationDirPath() + "/config.ini", QSettings::IniFormat);
+    return settings;
 }
 
 void SettingDialog::setupUi() {
     auto *mainLayout = new QVBoxLayout(this);
     auto *tabs = new QTabWidget();
-    QSettings *settings = getSettings();
+    QSettings *settings = &getSettings();
 
     auto *tabCameras = new QWidget();
     auto *camVBox = new QVBoxLayout(tabCameras);
@@ -36,11 +46,13 @@ void SettingDialog::setupUi() {
 
     int savedProto = settings->value("protocol_index", 0).toInt();
     comboProtocol->setCurrentIndex(savedProto);
-    connect(comboProtocol, SIGNAL(currentIndexChanged(int)), this, SLOT(onProtocolChanged(int)));
 
-    editUrlTemplate = new QLineEdit();
-    QString defaultTmpl = "http://%3/cgi-bin/snapshot.cgi?channel=1";
-    editUrlTemplate->setText(settings->value("rtsp_template", defaultTmpl).toString());
+    // Osobny szablon na protokół - kamery HTTP i RTSP można mieszać (źródło per kamera)
+    editHttpTemplate = new QLineEdit();
+    editHttpTemplate->setText(getUrlTemplate(0));
+
+    editRtspTemplate = new QLineEdit();
+    editRtspTemplate->setText(getUrlTemplate(1));
 
     auto *helpLabel = new QLabel(
         "<b>Legenda:</b> "
@@ -53,7 +65,8 @@ void SettingDialog::setupUi() {
     helpLabel->setStyleSheet("color: #555; font-size: 11px; margin-top: 5px;");
 
     templateLayout->addRow("Protokół:", comboProtocol);
-    templateLayout->addRow("Szablon URL:", editUrlTemplate);
+    templateLayout->addRow("Szablon URL HTTP:", editHttpTemplate);
+    templateLayout->addRow("Szablon URL RTSP:", editRtspTemplate);
     templateLayout->addWidget(helpLabel);
     camVBox->addWidget(grpTemplate);
 
@@ -71,15 +84,26 @@ void SettingDialog::setupUi() {
     authLayout->addRow("Hasło (%2):", editGlobalPass);
     camVBox->addWidget(grpAuth);
 
-    auto *grpList = new QGroupBox("Adresy IP (%3) i Obrót");
+    auto *grpList = new QGroupBox("Źródło, Adres IP (%3) / plik, Obrót i Obszar (ROI)");
     auto *gridCam = new QGridLayout(grpList);
 
     cameraRows.clear();
     for(int i=0; i<5; i++) {
         gridCam->addWidget(new QLabel(QString("Kamera %1:").arg(i+1)), i, 0);
 
+        // Dane = CameraSource::Kind + 1, 0 = protokół globalny
+        auto *comboSource = new QComboBox();
+        comboSource->addItem("Protokół globalny", 0);
+        comboSource->addItem("HTTP", 1);
+        comboSource->addItem("RTSP", 2);
+        comboSource->addItem("Plik (test)", 3);
+        comboSource->addItem("Syntetyczne (demo)", 4);
+        int srcIdx = comboSource->findData(settings->value(QString("camera_%1_source").arg(i), 0).toInt());
+        if(srcIdx != -1) comboSource->setCurrentIndex(srcIdx);
+
         auto *editIp = new QLineEdit();
         editIp->setPlaceholderText("192.168.160.xx");
+        editIp->setToolTip("Adres IP kamery, a dla źródła \"Plik\" ścieżka do zdjęcia");
         editIp->setText(settings->value(QString("camera_%1_ip").arg(i), "").toString());
 
         auto *comboRot = new QComboBox();
@@ -92,12 +116,21 @@ void SettingDialog::setupUi() {
         int idx = comboRot->findData(savedRot);
         if(idx != -1) comboRot->setCurrentIndex(idx);
 
-        gridCam->addWidget(editIp, i, 1);
-        gridCam->addWidget(comboRot, i, 2);
+        auto *editRoi = new QLineEdit();
+        editRoi->setPlaceholderText("ROI x,y,szer,wys % (puste = całość)");
+        editRoi->setToolTip("Obszar po obrocie w procentach kadru, np. 10,0,80,100");
+        editRoi->setText(settings->value(QString("camera_%1_roi").arg(i), "").toString());
+
+        gridCam->addWidget(comboSource, i, 1);
+        gridCam->addWidget(editIp, i, 2);
+        gridCam->addWidget(comboRot, i, 3);
+        gridCam->addWidget(editRoi, i, 4);
 
         CameraRow row{};
+        row.sourceCombo = comboSource;
         row.ipEdit = editIp;
         row.rotationCombo = comboRot;
+        row.roiEdit = editRoi;
         cameraRows.push_back(row);
     }
     camVBox->addWidget(grpList);
@@ -113,6 +146,12 @@ void SettingDialog::setupUi() {
     scanVBox->addWidget(new QLabel("Źródło Skanera:"));
     scanVBox->addWidget(scannerSelector);
     scanVBox->addWidget(btnRefresh);
+
+    checkSpeculative = new QCheckBox("Zdjęcia od pierwszego znaku kodu (spekulatywnie)");
+    checkSpeculative->setToolTip("Kamery ruszają, zanim skaner dośle cały kod - "
+                                 "kod palety jest dopisywany po terminatorze, szum odrzucany");
+    checkSpeculative->setChecked(settings->value("speculative_capture", false).toBool());
+    scanVBox->addWidget(checkSpeculative);
     scanVBox->addStretch();
     tabs->addTab(tabScanner, "Skaner");
 
@@ -131,6 +170,8 @@ void SettingDialog::setupUi() {
     checkFullScreen->setChecked(settings->value("fullscreen", true).toBool());
 
     editServerUrl = new QLineEdit();
+    editServerUrl->setToolTip("Kilka serwerów: adresy oddzielone przecinkiem - "
+                              "wysyłka rozkłada się na zdrowe, awaria jednego przenosi ruch na pozostałe");
     editServerUrl->setText(settings->value("server_url", "http://192.168.130.60:8000/php/upload.php").toString());
 
     spinTimeout = new QSpinBox();
@@ -141,109 +182,347 @@ void SettingDialog::setupUi() {
     sysLayout->addRow("Szerokość:", spinWidth);
     sysLayout->addRow("Wysokość:", spinHeight);
     sysLayout->addRow("", checkFullScreen);
-    sysLayout->addRow("Adres URL Servera:", editServerUrl);
+    sysLayout->addRow("Adresy URL Serwerów:", editServerUrl);
     sysLayout->addRow("Limit czasu (Timeout):", spinTimeout);
 
+    comboSink = new QComboBox();
+    comboSink->addItem("HTTP (upload.php)", 0);
+    comboSink->addItem("PostgreSQL (bezpośrednio)", 1);
+    comboSink->setCurrentIndex(settings->value("upload_sink", 0).toInt());
+
+    editPgConnInfo = new QLineEdit();
+    editPgConnInfo->setPlaceholderText("host=localhost dbname=magazyn user=skaner password=...");
+    editPgConnInfo->setText(settings->value("pg_conninfo", "").toString());
+
+    checkPgImages = new QCheckBox("Zapisuj zdjęcia w bazie (bytea)");
+    checkPgImages->setChecked(settings->value("pg_store_images", false).toBool());
+
+    spinMemoryBudget = new QSpinBox();
+    spinMemoryBudget->setRange(128, 16384);
+    spinMemoryBudget->setSingleStep(128);
+    spinMemoryBudget->setSuffix(" MB");
+    spinMemoryBudget->setValue(settings->value("memory_budget_mb", 1024).toInt());
+
+    checkSpool = new QCheckBox("Spool zdjęć (jeden plik mapowany zamiast plików w tmp/)");
+    checkSpool->setChecked(settings->value("spool_enabled", false).toBool());
+
+    spinSpoolSize = new QSpinBox();
+    spinSpoolSize->setRange(64, 65536);
+    spinSpoolSize->setSingleStep(256);
+    spinSpoolSize->setSuffix(" MB");
+    spinSpoolSize->setValue(settings->value("spool_size_mb", 1024).toInt());
+
+    // Koder zdjęć: formaty bez kodera w OpenCV widoczne, ale zapis i tak pójdzie jako JPEG
+    comboEncoder = new QComboBox();
+    for (int f = 0; f < ImageEncoder::FormatCount; f++) {
+        QString label = ImageEncoder::name(f);
+        if (!ImageEncoder::isAvailable(f)) label += " (niedostępny w OpenCV)";
+        comboEncoder->addItem(label, f);
+    }
+    if (int idx = comboEncoder->findData(settings->value("encoder_format", 0).toInt()); idx != -1)
+        comboEncoder->setCurrentIndex(idx);
+
+    spinEncoderQuality = new QSpinBox();
+    spinEncoderQuality->setRange(1, 100);
+    spinEncoderQuality->setValue(settings->value("encoder_quality", 85).toInt());
+
+    checkJpegProgressive = new QCheckBox("Progresywny");
+    checkJpegProgressive->setChecked(settings->value("jpeg_progressive", true).toBool());
+    checkJpegOptimize = new QCheckBox("Optymalizacja Huffmana");
+    checkJpegOptimize->setChecked(settings->value("jpeg_optimize", true).toBool());
+
+    comboJpegSubsampling = new QComboBox();
+    comboJpegSubsampling->addItem("4:2:0", 420);
+    comboJpegSubsampling->addItem("4:2:2", 422);
+    comboJpegSubsampling->addItem("4:4:4", 444);
+    if (int idx = comboJpegSubsampling->findData(settings->value("jpeg_subsampling", 420).toInt()); idx != -1)
+        comboJpegSubsampling->setCurrentIndex(idx);
+
+    auto *jpegLayout = new QHBoxLayout();
+    jpegLayout->addWidget(checkJpegProgressive);
+    jpegLayout->addWidget(checkJpegOptimize);
+    jpegLayout->addWidget(comboJpegSubsampling);
+
+    // Strojenie dotyczy tylko JPEG (libjpeg-turbo)
+    auto updateJpegOptions = [this]() {
+        const bool tuned = comboEncoder->currentData().toInt() == ImageEncoder::JpegTuned;
+        checkJpegProgressive->setEnabled(tuned);
+        checkJpegOptimize->setEnabled(tuned);
+        comboJpegSubsampling->setEnabled(tuned);
+    };
+    connect(comboEncoder, &QComboBox::currentIndexChanged, this, updateJpegOptions);
+    updateJpegOptions();
+
+    spinHedge = new QSpinBox();
+    spinHedge->setRange(0, 50);
+    spinHedge->setSuffix(" % żądań");
+    spinHedge->setSpecialValueText("Wyłączony");
+    spinHedge->setToolTip("Drugie żądanie HTTP, gdy kamera nie odpowie w swoim p90");
+    spinHedge->setValue(settings->value("hedge_percent", 10).toInt());
+
+    spinDeadline = new QSpinBox();
+    spinDeadline->setRange(10, 86400);
+    spinDeadline->setSuffix(" s");
+    spinDeadline->setValue(settings->value("upload_deadline_s", 120).toInt());
+
+    comboBacklog = new QComboBox();
+    comboBacklog->addItem("Wysyłaj kolejno", 0);
+    comboBacklog->addItem("Zmniejsz rozdzielczość", 1);
+    comboBacklog->addItem("Odłóż poza szczyt", 2);
+    if (int idx = comboBacklog->findData(settings->value("backlog_policy", 0).toInt()); idx != -1)
+        comboBacklog->setCurrentIndex(idx);
+
+    spinOffPeakFrom = new QSpinBox();
+    spinOffPeakFrom->setRange(0, 23);
+    spinOffPeakFrom->setSuffix(":00");
+    spinOffPeakFrom->setValue(settings->value("offpeak_from", 22).toInt());
+
+    spinOffPeakTo = new QSpinBox();
+    spinOffPeakTo->setRange(0, 23);
+    spinOffPeakTo->setSuffix(":00");
+    spinOffPeakTo->setValue(settings->value("offpeak_to", 6).toInt());
+
+    auto *offPeakLayout = new QHBoxLayout();
+    offPeakLayout->addWidget(spinOffPeakFrom);
+    offPeakLayout->addWidget(new QLabel("-"));
+    offPeakLayout->addWidget(spinOffPeakTo);
+
+    spinUploadRate = new QSpinBox();
+    spinUploadRate->setRange(0, 100000);
+    spinUploadRate->setSingleStep(128);
+    spinUploadRate->setSuffix(" KB/s");
+    spinUploadRate->setSpecialValueText("Bez limitu");
+    spinUploadRate->setValue(settings->value("upload_rate_kbps", 0).toInt());
+
+    checkUploadYield = new QCheckBox("Ustępuj kamerom w trakcie pobierania zdjęć");
+    checkUploadYield->setChecked(settings->value("upload_yield", false).toBool());
+
+    sysLayout->addRow("Limit wysyłania:", spinUploadRate);
+    sysLayout->addRow("", checkUploadYield);
+    sysLayout->addRow("Termin wysyłki zdjęcia:", spinDeadline);
+    sysLayout->addRow("Zaległe po terminie:", comboBacklog);
+    sysLayout->addRow("Poza szczytem:", offPeakLayout);
+    sysLayout->addRow("Hedging zdjęć HTTP:", spinHedge);
+    sysLayout->addRow("Budżet pamięci zdjęć:", spinMemoryBudget);
+    sysLayout->addRow("Zapis zdjęć:", checkSpool);
+    sysLayout->addRow("Rozmiar spoola (restart):", spinSpoolSize);
+    sysLayout->addRow("Format zdjęć:", comboEncoder);
+    sysLayout->addRow("Jakość zdjęć:", spinEncoderQuality);
+    sysLayout->addRow("Opcje JPEG:", jpegLayout);
+    sysLayout->addRow("Odbiorca danych (restart):", comboSink);
+    sysLayout->addRow("PostgreSQL conninfo:", editPgConnInfo);
+    sysLayout->addRow("", checkPgImages);
+
     tabs->addTab(tabSystem, "System");
 
-    auto *btnSave = new QPushButton("ZAPISZ I ZRESETUJ");
+    auto *btnSave = new QPushButton("ZAPISZ I ZASTOSUJ");
     btnSave->setStyleSheet("background-color: #d32f2f; color: white; font-weight: bold; padding: 10px;");
     connect(btnSave, &QPushButton::clicked, this, &SettingDialog::saveSettings);
 
     mainLayout->addWidget(tabs);
     mainLayout->addWidget(btnSave);
 
-    delete settings;
     refreshPorts();
 }
 
-void SettingDialog::onProtocolChanged(int index) const {
-    if (index == 0) {
-        editUrlTemplate->setText("http://%3/cgi-bin/snapshot.cgi?channel=1");
-    } else {
-        // editUrlTemplate->setText("rtsp://%3/h264.sdp");
-        editUrlTemplate->setText("rtsp://%1:%2@%3:554/cam/realmonitor?channel=1&subtype=0&proto=Onvif");
+void SettingDialog::refreshPorts() {
+    if (portWatcher && portWatcher->isRunning()) return;
+
+    // Zapisany port pokazujemy od razu, żeby "Zapisz" przed końcem skanowania go nie nadpisał
+    const QString savedPort = getSelectedScannerPort();
+    scannerSelector->clear();
+    scannerSelector->addItem("Klawiatura / HID", "KEYBOARD");
+    if (savedPort != "KEYBOARD") {
+        scannerSelector->addItem(savedPort + " (szukanie portów...)", savedPort);
+        scannerSelector->setCurrentIndex(1);
+    }
+
+    // Enumeracja portów potrafi trwać setki ms (USB/Bluetooth) - robimy ją w tle
+    if (!portWatcher) {
+        portWatcher = new QFutureWatcher<QList<QSerialPortInfo>>(this);
+        connect(portWatcher, &QFutureWatcherBase::finished, this, &SettingDialog::onPortsEnumerated);
     }
+    portWatcher->setFuture(QtConcurrent::run(&QSerialPortInfo::availablePorts));
 }
 
-void SettingDialog::refreshPorts() const {
-    const QSettings *settings = getSettings();
-    const QString savedPort = settings->value("scanner_port", "KEYBOARD").toString();
-    delete settings;
+void SettingDialog::onPortsEnumerated() {
+    const QString current = scannerSelector->currentData().toString();
 
     scannerSelector->clear();
     scannerSelector->addItem("Klawiatura / HID", "KEYBOARD");
 
-    const auto infos = QSerialPortInfo::availablePorts();
+    const auto infos = portWatcher->result();
     for (const QSerialPortInfo &info : infos) {
         QString label = info.portName();
         if(!info.description().isEmpty()) label += " (" + info.description() + ")";
         scannerSelector->addItem(label, info.portName());
     }
 
-    if(const int idx = scannerSelector->findData(savedPort); idx != -1) scannerSelector->setCurrentIndex(idx);
+    if(const int idx = scannerSelector->findData(current); idx != -1) scannerSelector->setCurrentIndex(idx);
 }
 
 void SettingDialog::saveSettings() {
-    QSettings *settings = getSettings();
+    // Odbiorca HTTP bez adresu nie wyśle żadnego zdjęcia
+    if (comboSink->currentData().toInt() == 0 && splitServerUrls(editServerUrl->text()).isEmpty()) {
+        QMessageBox::warning(this, "Adresy URL Serwerów", "Podaj co najmniej jeden adres serwera uploadu.");
+        editServerUrl->setFocus();
+        return;
+    }
+
+    QSettings *settings = &getSettings();
 
     settings->setValue("protocol_index", comboProtocol->currentIndex());
-    settings->setValue("rtsp_template", editUrlTemplate->text());
+    settings->setValue("url_template_http", editHttpTemplate->text());
+    settings->setValue("url_template_rtsp", editRtspTemplate->text());
     settings->setValue("cam_user", editGlobalUser->text());
     settings->setValue("cam_pass", editGlobalPass->text());
 
     for(size_t i=0; i<cameraRows.size(); i++) {
+        settings->setValue(QString("camera_%1_source").arg(i), cameraRows[i].sourceCombo->currentData());
         settings->setValue(QString("camera_%1_ip").arg(i), cameraRows[i].ipEdit->text());
         settings->setValue(QString("camera_%1_rot").arg(i), cameraRows[i].rotationCombo->currentData());
+        settings->setValue(QString("camera_%1_roi").arg(i), cameraRows[i].roiEdit->text().trimmed());
     }
 
     settings->setValue("scanner_port", scannerSelector->currentData().toString());
+    settings->setValue("speculative_capture", checkSpeculative->isChecked());
     settings->setValue("app_width", spinWidth->value());
     settings->setValue("app_height", spinHeight->value());
     settings->setValue("fullscreen", checkFullScreen->isChecked());
     settings->setValue("server_url", editServerUrl->text());
     settings->setValue("upload_timeout", spinTimeout->value());
-
-    delete settings;
+    settings->setValue("upload_sink", comboSink->currentData());
+    settings->setValue("pg_conninfo", editPgConnInfo->text());
+    settings->setValue("pg_store_images", checkPgImages->isChecked());
+    settings->setValue("memory_budget_mb", spinMemoryBudget->value());
+    settings->setValue("hedge_percent", spinHedge->value());
+    settings->setValue("spool_enabled", checkSpool->isChecked());
+    settings->setValue("spool_size_mb", spinSpoolSize->value());
+    settings->setValue("encoder_format", comboEncoder->currentData());
+    settings->setValue("encoder_quality", spinEncoderQuality->value());
+    settings->setValue("jpeg_progressive", checkJpegProgressive->isChecked());
+    settings->setValue("jpeg_optimize", checkJpegOptimize->isChecked());
+    settings->setValue("jpeg_subsampling", comboJpegSubsampling->currentData());
+    settings->setValue("upload_deadline_s", spinDeadline->value());
+    settings->setValue("upload_rate_kbps", spinUploadRate->value());
+    settings->setValue("upload_yield", checkUploadYield->isChecked());
+    settings->setValue("backlog_policy", comboBacklog->currentData());
+    settings->setValue("offpeak_from", spinOffPeakFrom->value());
+    settings->setValue("offpeak_to", spinOffPeakTo->value());
+
+    settings->sync();
     accept();
 }
 
 int SettingDialog::getProtocolMode() {
-    QSettings *s = getSettings(); int v = s->value("protocol_index", 0).toInt(); delete s; return v;
+    return getSettings().value("protocol_index", 0).toInt();
 }
-QString SettingDialog::getUrlTemplate() {
-    const QSettings *s = getSettings();
-    const QString defaultTmpl = "http://%3/cgi-bin/snapshot.cgi?channel=1";
-    QString v = s->value("rtsp_template", defaultTmpl).toString();
-    delete s; return v;
+QString SettingDialog::getUrlTemplate(int protocol) {
+    QSettings &settings = getSettings();
+    const char *key = protocol == 1 ? "url_template_rtsp" : "url_template_http";
+    if (settings.contains(key)) return settings.value(key).toString();
+
+    // Starsza konfiguracja: jeden szablon (rtsp_template) dla protokołu globalnego
+    if (protocol == getProtocolMode() && settings.contains("rtsp_template"))
+        return settings.value("rtsp_template").toString();
+    return protocol == 1 ? "rtsp://%1:%2@%3:554/cam/realmonitor?channel=1&subtype=0&proto=Onvif"
+                         : "http://%3/cgi-bin/snapshot.cgi?channel=1";
 }
 QString SettingDialog::getCameraIp(int index) {
-    const QSettings *s = getSettings(); QString v = s->value(QString("camera_%1_ip").arg(index), "").toString(); delete s; return v;
+    return getSettings().value(QString("camera_%1_ip").arg(index), "").toString();
+}
+int SettingDialog::getCameraSource(int index) {
+    const int saved = getSettings().value(QString("camera_%1_source").arg(index), 0).toInt();
+    return saved > 0 ? saved - 1 : getProtocolMode();
 }
 int SettingDialog::getCameraRotation(int index) {
-    const QSettings *s = getSettings(); int v = s->value(QString("camera_%1_rot").arg(index), 0).toInt(); delete s; return v;
+    return getSettings().value(QString("camera_%1_rot").arg(index), 0).toInt();
+}
+QRectF SettingDialog::getCameraRoi(int index) {
+    const QStringList parts = getSettings().value(QString("camera_%1_roi").arg(index), "").toString().split(',');
+    if (parts.size() != 4) return QRectF();
+
+    double v[4];
+    for (int k = 0; k < 4; k++) {
+        bool ok = false;
+        v[k] = parts[k].trimmed().toDouble(&ok) / 100.0;
+        if (!ok || v[k] < 0.0 || v[k] > 1.0) return QRectF();
+    }
+    return QRectF(v[0], v[1], v[2], v[3]).intersected(QRectF(0, 0, 1, 1));
 }
 QString SettingDialog::getGlobalUser() {
-    const QSettings *s = getSettings(); QString v = s->value("cam_user", "snapshot1").toString(); delete s; return v;
+    return getSettings().value("cam_user", "snapshot1").toString();
 }
 QString SettingDialog::getGlobalPass() {
-    const QSettings *s = getSettings(); QString v = s->value("cam_pass", "snapshot1").toString(); delete s; return v;
+    return getSettings().value("cam_pass", "snapshot1").toString();
 }
 QString SettingDialog::getSelectedScannerPort() {
-    const QSettings *s = getSettings(); QString v = s->value("scanner_port", "KEYBOARD").toString(); delete s; return v;
+    return getSettings().value("scanner_port", "KEYBOARD").toString();
+}
+bool SettingDialog::getSpeculativeCapture() {
+    return getSettings().value("speculative_capture", false).toBool();
 }
 int SettingDialog::getAppWidth() {
-    const QSettings *s = getSettings(); int v = s->value("app_width", 1920).toInt(); delete s; return v;
+    return getSettings().value("app_width", 1920).toInt();
 }
 int SettingDialog::getAppHeight() {
-    const QSettings *s = getSettings(); int v = s->value("app_height", 1080).toInt(); delete s; return v;
+    return getSettings().value("app_height", 1080).toInt();
 }
 bool SettingDialog::isFullScreen() {
-    const QSettings *s = getSettings(); bool v = s->value("fullscreen", true).toBool(); delete s; return v;
+    return getSettings().value("fullscreen", true).toBool();
 }
-QString SettingDialog::getServerUrl() {
-    const QSettings *s = getSettings(); QString v = s->value("server_url", "http://192.168.130.60:8000/php/upload.php").toString(); delete s; return v;
+QStringList SettingDialog::getServerUrls() {
+    return splitServerUrls(getSettings().value("server_url", "http://192.168.130.60:8000/php/upload.php").toString());
 }
 int SettingDialog::getUploadTimeout() {
-    const QSettings *s = getSettings(); int v = s->value("upload_timeout", 5).toInt(); delete s; return v;
+    return getSettings().value("upload_timeout", 5).toInt();
+}
+int SettingDialog::getUploadSink() {
+    return getSettings().value("upload_sink", 0).toInt();
+}
+QString SettingDialog::getPgConnInfo() {
+    return getSettings().value("pg_conninfo", "").toString();
+}
+bool SettingDialog::getPgStoreImages() {
+    return getSettings().value("pg_store_images", false).toBool();
+}
+int SettingDialog::getMemoryBudgetMb() {
+    return getSettings().value("memory_budget_mb", 1024).toInt();
+}
+int SettingDialog::getHedgePercent() {
+    return getSettings().value("hedge_percent", 10).toInt();
+}
+bool SettingDialog::getSpoolEnabled() {
+    return getSettings().value("spool_enabled", false).toBool();
+}
+int SettingDialog::getSpoolSizeMb() {
+    return getSettings().value("spool_size_mb", 1024).toInt();
+}
+ImageEncoder::Settings SettingDialog::getEncoderSettings() {
+    QSettings &settings = getSettings();
+    ImageEncoder::Settings s;
+    s.format = settings.value("encoder_format", 0).toInt();
+    s.quality = settings.value("encoder_quality", 85).toInt();
+    s.progressive = settings.value("jpeg_progressive", true).toBool();
+    s.optimize = settings.value("jpeg_optimize", true).toBool();
+    s.subsampling = settings.value("jpeg_subsampling", 420).toInt();
+    return s;
+}
+int SettingDialog::getUploadDeadline() {
+    return getSettings().value("upload_deadline_s", 120).toInt();
+}
+int SettingDialog::getBacklogPolicy() {
+    return getSettings().value("backlog_policy", 0).toInt();
+}
+int SettingDialog::getOffPeakFrom() {
+    return getSettings().value("offpeak_from", 22).toInt();
+}
+int SettingDialog::getOffPeakTo() {
+    return getSettings().value("offpeak_to", 6).toInt();
+}
+int SettingDialog::getUploadRateKbps() {
+    return getSettings().value("upload_rate_kbps", 0).toInt();
+}
+bool SettingDialog::getUploadYield() {
+    return getSettings().value("upload_yield", false).toBool();
 }
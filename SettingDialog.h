@@ -7,54 +7,104 @@
 #include <QSettings>
 #include <QSpinBox>
 #include <QCheckBox>
+#include <QRectF>
+#include <QStringList>
+#include <QFutureWatcher>
+#include <QSerialPortInfo>
 #include <vector>
+#include "ImageEncoder.h"
 
 class SettingDialog : public QDialog {
     Q_OBJECT
 public:
     explicit SettingDialog(QWidget *parent = nullptr);
 
-    static QString getCameraIp(int index);
-    int getCameraRotation(int index);
-    QString getGlobalUser();
-    QString getGlobalPass();
-    QString getUrlTemplate();
-    int getProtocolMode();
+    // Gettery są statyczne - MainWindow czyta konfigurację bez tworzenia dialogu
+    static QString getCameraIp(int index);    // Dla źródła "Plik" - ścieżka do zdjęcia
+    static int getCameraSource(int index);    // CameraSource::Kind (domyślnie wg protokołu globalnego)
+    static int getCameraRotation(int index);
+    static QRectF getCameraRoi(int index); // Ułamki 0..1, pusty = cała klatka
+    static QString getGlobalUser();
+    static QString getGlobalPass();
+    static QString getUrlTemplate(int protocol); // 0 = HTTP, 1 = RTSP (CameraSource::Http / Rtsp)
+    static int getProtocolMode();
 
-    QString getSelectedScannerPort();
-    int getAppWidth();
-    int getAppHeight();
-    bool isFullScreen();
-    QString getServerUrl();
-    int getUploadTimeout();
+    static QString getSelectedScannerPort();
+    static bool getSpeculativeCapture(); // Kamery od pierwszego znaku kodu
+    static int getAppWidth();
+    static int getAppHeight();
+    static bool isFullScreen();
+    static QStringList getServerUrls(); // server_url: jeden lub kilka adresów (przecinek / spacja)
+    static int getUploadTimeout();
+    static int getUploadSink(); // 0 = HTTP (upload.php), 1 = PostgreSQL
+    static QString getPgConnInfo();
+    static bool getPgStoreImages();
+    static int getMemoryBudgetMb();
+    static int getHedgePercent(); // 0 = bez dodatkowych żądań HTTP
+    static bool getSpoolEnabled();
+    static int getSpoolSizeMb(); // Rozmiar pliku ustalany przy otwarciu (restart)
+    static ImageEncoder::Settings getEncoderSettings(); // Jak zapisane - dostępność sprawdza effective()
+    static int getUploadDeadline(); // Sekundy od zrobienia zdjęcia
+    static int getBacklogPolicy();  // UploadPolicy::Backlog
+    static int getOffPeakFrom();
+    static int getOffPeakTo();
+    static int getUploadRateKbps(); // 0 = bez limitu
+    static bool getUploadYield();
 
 public slots:
     void saveSettings();
-    void refreshPorts() const;
-    void onProtocolChanged(int index) const;
+    void refreshPorts();
+
+private slots:
+    void onPortsEnumerated();
 
 private:
     void setupUi();
 
-    static QSettings* getSettings();
+    // Jedna instancja na cały proces - config.ini parsowany tylko raz
+    static QSettings &getSettings();
 
     struct CameraRow {
+        QComboBox *sourceCombo;
         QLineEdit *ipEdit;
         QComboBox *rotationCombo;
+        QLineEdit *roiEdit;
     };
 
     QLineEdit *editGlobalUser;
     QLineEdit *editGlobalPass;
     QComboBox *comboProtocol;
-    QLineEdit *editUrlTemplate;
+    QLineEdit *editHttpTemplate;
+    QLineEdit *editRtspTemplate;
 
     std::vector<CameraRow> cameraRows;
     QComboBox *scannerSelector;
+    QCheckBox *checkSpeculative;
     QSpinBox *spinWidth;
     QSpinBox *spinHeight;
     QCheckBox *checkFullScreen;
     QLineEdit *editServerUrl;
     QSpinBox *spinTimeout;
+    QComboBox *comboSink;
+    QLineEdit *editPgConnInfo;
+    QCheckBox *checkPgImages;
+    QSpinBox *spinMemoryBudget;
+    QSpinBox *spinHedge;
+    QCheckBox *checkSpool;
+    QSpinBox *spinSpoolSize;
+    QComboBox *comboEncoder;
+    QSpinBox *spinEncoderQuality;
+    QCheckBox *checkJpegProgressive;
+    QCheckBox *checkJpegOptimize;
+    QComboBox *comboJpegSubsampling;
+    QSpinBox *spinDeadline;
+    QComboBox *comboBacklog;
+    QSpinBox *spinOffPeakFrom;
+    QSpinBox *spinOffPeakTo;
+    QSpinBox *spinUploadRate;
+    QCheckBox *checkUploadYield;
+
+    QFutureWatcher<QList<QSerialPortInfo>> *portWatcher;
 };
 
 #endif
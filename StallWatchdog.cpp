@@ -0,0 +1,145 @@
+#include "StallWatchdog.h"
+#include "Metrics.h"
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <execinfo.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdlib>
+#endif
+
+namespace {
+const int kHeartbeatMs = 50;
+std::atomic<const char*> g_currentScope{ nullptr };
+
+#ifdef Q_OS_LINUX
+const int kSampleSignal = SIGUSR2;
+const int kMaxFrames = 48;
+const int kHandlerFrames = 2; // sampleHandler + ramka sygnału jądra
+void *g_frames[kMaxFrames];
+std::atomic<int> g_frameCount{ -1 };
+
+// Handler sygnału na wątku GUI: tylko zrzut adresów, symbole rozwiązuje watchdog
+void sampleHandler(int) {
+    const int savedErrno = errno;
+    g_frameCount.store(backtrace(g_frames, kMaxFrames), std::memory_order_release);
+    errno = savedErrno;
+}
+#endif
+}
+
+// =========================================================
+// STALL SCOPE
+// =========================================================
+StallScope::StallScope(const char *name)
+    : m_previous(g_currentScope.exchange(name, std::memory_order_relaxed)) {}
+
+StallScope::~StallScope() {
+    g_currentScope.store(m_previous, std::memory_order_relaxed);
+}
+
+const char *StallScope::current() {
+    return g_currentScope.load(std::memory_order_relaxed);
+}
+
+// =========================================================
+// STALL WATCHDOG
+// =========================================================
+StallWatchdog::StallWatchdog(int thresholdMs, QObject *parent)
+    : QThread(parent), m_thresholdMs(thresholdMs), m_postedNs(0), m_doneNs(0)
+{
+    setObjectName("StallWatchdog");
+    m_clock.start();
+
+#ifdef Q_OS_LINUX
+    m_guiThread = pthread_self();
+
+    // SA_RESTART - próbka nie może przerwać blokującego wywołania wątku GUI błędem EINTR
+    struct sigaction sa = {};
+    sa.sa_handler = sampleHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(kSampleSignal, &sa, nullptr);
+
+    // Pierwsze backtrace() ładuje libgcc - robimy to tutaj, a nie w handlerze sygnału
+    void *warmup[1];
+    backtrace(warmup, 1);
+#endif
+}
+
+StallWatchdog::~StallWatchdog() {
+    requestInterruption();
+    wait();
+}
+
+void StallWatchdog::postHeartbeat(qint64 nowNs) {
+    m_postedNs.store(nowNs);
+    // Obiekt QThread żyje w wątku GUI - lambda wykona się w jego pętli zdarzeń
+    QMetaObject::invokeMethod(this, [this]() {
+        m_doneNs.store(m_clock.nsecsElapsed());
+    }, Qt::QueuedConnection);
+}
+
+QStringList StallWatchdog::sampleGuiStack() {
+    QStringList stack;
+#ifdef Q_OS_LINUX
+    g_frameCount.store(-1, std::memory_order_release);
+    if (pthread_kill(m_guiThread, kSampleSignal) != 0) return stack;
+
+    int frames = -1;
+    for (int k = 0; k < 50 && frames < 0; k++) {
+        QThread::usleep(1000);
+        frames = g_frameCount.load(std::memory_order_acquire);
+    }
+    if (frames <= kHandlerFrames) return stack;
+
+    char **symbols = backtrace_symbols(g_frames, frames);
+    if (!symbols) return stack;
+    for (int k = kHandlerFrames; k < frames; k++) stack << QString::fromLocal8Bit(symbols[k]);
+    free(symbols);
+#endif
+    return stack;
+}
+
+void StallWatchdog::run() {
+    bool stalled = false;
+    const char *stallScope = nullptr;
+    QStringList stallStack;
+
+    postHeartbeat(m_clock.nsecsElapsed());
+
+    while (!isInterruptionRequested()) {
+        msleep(kHeartbeatMs);
+
+        const qint64 nowNs = m_clock.nsecsElapsed();
+        const qint64 postedNs = m_postedNs.load();
+        const qint64 doneNs = m_doneNs.load();
+
+        if (doneNs >= postedNs) {
+            const double latencyMs = double(doneNs - postedNs) / 1e6;
+            Metrics::set("gui_event_loop_latency_ms", latencyMs);
+
+            if (stalled) {
+                stalled = false;
+                qWarning().noquote() << QString("GUI STALL: %1 ms in %2")
+                                        .arg(latencyMs, 0, 'f', 0)
+                                        .arg(stallScope ? stallScope : "(nieoznaczony handler)");
+                for (const QString &frame : stallStack) qWarning().noquote() << "    " << frame;
+
+                Metrics::add("gui_stalls_total", 1);
+                Metrics::add("gui_stall_ms_total", latencyMs);
+                if (latencyMs > Metrics::value("gui_stall_max_ms")) Metrics::set("gui_stall_max_ms", latencyMs);
+            }
+            postHeartbeat(nowNs);
+        } else if (!stalled && nowNs - postedNs > qint64(m_thresholdMs) * 1000000) {
+            // Próbka w trakcie zawieszenia - stos pokazuje, co naprawdę blokuje
+            stalled = true;
+            stallScope = StallScope::current();
+            stallStack = sampleGuiStack();
+            qWarning().noquote() << QString("GUI STALL: > %1 ms, trwa (%2)")
+                                    .arg(m_thresholdMs)
+                                    .arg(stallScope ? stallScope : "(nieoznaczony handler)");
+        }
+    }
+}
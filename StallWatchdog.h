@@ -0,0 +1,54 @@
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <QThread>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <atomic>
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#endif
+
+// --- ZNACZNIK OBSŁUGI (RAII, tylko wątek GUI) ---
+// Oznacza slot/handler, który właśnie działa - watchdog dopisuje go do zgłoszenia
+// zawieszenia. Nazwa musi być literałem (np. Q_FUNC_INFO), zagnieżdżanie dozwolone.
+class StallScope {
+public:
+    explicit StallScope(const char *name);
+    ~StallScope();
+
+    static const char *current();
+
+private:
+    const char *m_previous;
+};
+
+// --- WATCHDOG PĘTLI ZDARZEŃ GUI ---
+// Wątek pomocniczy co kilkadziesiąt ms wrzuca "heartbeat" do kolejki GUI i mierzy,
+// po jakim czasie został obsłużony. Gdy czeka dłużej niż próg - zawieszenie: zapisuje
+// aktywny StallScope i (Linux) próbkę stosu wątku GUI. Po odblokowaniu loguje całość
+// i dolicza metryki gui_stalls_total / gui_stall_ms_total / gui_stall_max_ms.
+class StallWatchdog : public QThread {
+    Q_OBJECT
+public:
+    // Tworzyć i uruchamiać z wątku GUI
+    explicit StallWatchdog(int thresholdMs, QObject *parent = nullptr);
+    ~StallWatchdog() override;
+
+protected:
+    void run() override;
+
+private:
+    void postHeartbeat(qint64 nowNs);
+    QStringList sampleGuiStack();
+
+    const int m_thresholdMs;
+    QElapsedTimer m_clock;
+    std::atomic<qint64> m_postedNs;
+    std::atomic<qint64> m_doneNs;
+#ifdef Q_OS_LINUX
+    pthread_t m_guiThread;
+#endif
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QElapsedTimer>
+#include <QDebug>
+
+// --- PROFIL STARTU (znaczniki czasu kolejnych faz inicjalizacji) ---
+// Używany tylko z wątku GUI: main() -> konstruktor MainWindow -> finishStartup().
+namespace StartupProfiler {
+
+inline QElapsedTimer &clock() {
+    static QElapsedTimer timer;
+    return timer;
+}
+
+inline void start() {
+    clock().start();
+}
+
+// Loguje czas fazy (od poprzedniego znacznika) oraz czas od startu procesu
+inline void mark(const char *phase) {
+    static qint64 lastUs = 0;
+    if (!clock().isValid()) start();
+
+    const qint64 nowUs = clock().nsecsElapsed() / 1000;
+    qDebug().noquote() << QString("STARTUP: %1 +%2 ms (total %3 ms)")
+                          .arg(QString::fromLatin1(phase))
+                          .arg((nowUs - lastUs) / 1000.0, 0, 'f', 1)
+                          .arg(nowUs / 1000.0, 0, 'f', 1);
+    lastUs = nowUs;
+}
+
+} // namespace StartupProfiler
+
+#endif
@@ -0,0 +1,30 @@
+#include "StatusOverlay.h"
+#include <QPainter>
+#include <QPaintDevice>
+
+void StatusOverlay::paint(QPaintDevice *device, int status, const QString &msg) {
+    if (status <= None) return;
+
+    QPainter painter(device);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    QColor color;
+    QString text = msg;
+    if (status == Uploading) { color = QColor(0, 120, 215); if(text.isEmpty()) text="WYSYŁANIE..."; }
+    else if (status == Sent) { color = QColor(40, 167, 69); if(text.isEmpty()) text="WYSŁANO \u2714"; }
+    else { color = QColor(220, 53, 69); if(text.isEmpty()) text="BŁĄD \u274C"; }
+
+    int w = device->width();
+    int h = device->height();
+    int barHeight = qMax(30, h/12);
+
+    painter.fillRect(QRect(0, 0, w, barHeight), color);
+
+    painter.setPen(Qt::white);
+    QFont font = painter.font();
+    font.setPixelSize(barHeight * 0.7);
+    font.setBold(true);
+    painter.setFont(font);
+
+    painter.drawText(QRect(0, 0, w, barHeight), Qt::AlignCenter, text);
+}
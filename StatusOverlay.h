@@ -0,0 +1,17 @@
+#ifndef STATUSOVERLAY_H
+#define STATUSOVERLAY_H
+
+#include <QString>
+
+class QPaintDevice;
+
+namespace StatusOverlay {
+
+enum Status { None = 0, Uploading = 1, Sent = 2, Failed = 3 };
+
+// Pasek statusu wysyłki na górze obrazu (wysokość ~1/12 obrazu, min. 30 px)
+void paint(QPaintDevice *device, int status, const QString &msg = "");
+
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef UPLOADSINK_H
+#define UPLOADSINK_H
+
+#include <QObject>
+#include <QString>
+#include <QDateTime>
+
+struct UploadJob {
+    QString filePath;
+    QString palletCode;
+    int camIndex;
+    QDateTime capturedAt;
+    QDateTime deadline;    // Po terminie zdjęcie trafia do zaległych (polityka kolejki)
+    QDateTime enqueuedAt;  // Ustawiane przez odbiorcę przy przyjęciu
+    int attempts = 0;      // HTTP: próby wysyłki (failover na inny serwer)
+    QString endpoint;      // HTTP: serwer ostatniej próby - ponowienie idzie gdzie indziej
+    bool retry = false;    // Ponowienie ze spoola (odzysk, nieudana wysyłka) - nie zmienia bieżącej palety
+};
+
+// --- ODBIORCA DANYCH (wspólny interfejs: HTTP upload.php / PostgreSQL) ---
+// Implementacja żyje na własnym wątku, MainWindow rozmawia z nią tylko sygnałami.
+class UploadSink : public QObject {
+    Q_OBJECT
+public:
+    explicit UploadSink(QObject *parent = nullptr) : QObject(parent) {}
+
+public slots:
+    virtual void addJob(const UploadJob &job) = 0;
+
+signals:
+    void uploadStarted(int camIndex);
+    void uploadFinished(int camIndex, bool success, const QString &message);
+};
+
+#endif
@@ -0,0 +1,215 @@
+// Mikrobenchmarki kerneli obrazu wykonywanych dla każdego zdjęcia.
+//
+//   cmake -S . -B build -DMAGAZYN_BUILD_BENCHMARKS=ON && cmake --build build --target ImageKernelsBench
+//   ./build/ImageKernelsBench --benchmark_format=json --benchmark_out=kernels.json
+//
+// Argument "res": 0 = 1080p, 1 = 4MP, 2 = 4K. Wejście jest syntetyczne i deterministyczne,
+// więc wyniki z różnych buildów można porównywać kernel po kernelu.
+
+#include <benchmark/benchmark.h>
+#include <QGuiApplication>
+#include <QImage>
+#include <QBuffer>
+#include <QTransform>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include "../StatusOverlay.h"
+
+namespace {
+
+struct Resolution {
+    const char *name;
+    int width;
+    int height;
+};
+
+const Resolution kResolutions[] = {
+    { "1080p", 1920, 1080 },
+    { "4MP",   2688, 1520 },
+    { "4K",    3840, 2160 },
+};
+
+const QSize kLabelSize(640, 360); // Typowa etykieta kamery w oknie 1920x1080
+
+struct Inputs {
+    cv::Mat bgr;
+    QImage rgb;
+    QByteArray jpeg;
+};
+
+// Gradient + szum + pasy - JPEG o rozmiarze zbliżonym do zdjęć z kamer
+const Inputs &inputs(int res) {
+    static Inputs cache[3];
+    Inputs &in = cache[res];
+    if (in.bgr.empty()) {
+        const Resolution &r = kResolutions[res];
+        cv::RNG rng(12345);
+        in.bgr.create(r.height, r.width, CV_8UC3);
+        rng.fill(in.bgr, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(64));
+        for (int y = 0; y < r.height; y += 64)
+            cv::rectangle(in.bgr, cv::Rect(0, y, r.width, 32), cv::Scalar(40, 90 + y % 120, 160), cv::FILLED);
+
+        std::vector<uchar> buf;
+        cv::imencode(".jpg", in.bgr, buf, { cv::IMWRITE_JPEG_QUALITY, 85 });
+        in.jpeg = QByteArray(reinterpret_cast<const char*>(buf.data()), qsizetype(buf.size()));
+        in.rgb.loadFromData(in.jpeg, "JPG");
+        in.rgb = in.rgb.convertToFormat(QImage::Format_RGB888);
+    }
+    return in;
+}
+
+void setPixelCounters(benchmark::State &state, int res) {
+    const Resolution &r = kResolutions[res];
+    state.SetLabel(r.name);
+    state.counters["MPix/s"] = benchmark::Counter(r.width * double(r.height) / 1e6,
+                                                  benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// ---------------------------------------------------------
+// Kernele Qt (ścieżka pierwotna)
+// ---------------------------------------------------------
+void BM_QImageLoadFromData(benchmark::State &state) {
+    const int res = int(state.range(0));
+    const Inputs &in = inputs(res);
+    for (auto _ : state) {
+        QImage img;
+        benchmark::DoNotOptimize(img.loadFromData(in.jpeg, "JPG"));
+    }
+    setPixelCounters(state, res);
+}
+
+void BM_QImageTransformed(benchmark::State &state) {
+    const int res = int(state.range(0));
+    const int angle = int(state.range(1));
+    const Inputs &in = inputs(res);
+    QTransform trans;
+    trans.rotate(angle == 270 ? -90 : angle);
+    for (auto _ : state) {
+        QImage out = in.rgb.transformed(trans);
+        benchmark::DoNotOptimize(out.constBits());
+    }
+    setPixelCounters(state, res);
+}
+
+void BM_QImageSaveJpeg(benchmark::State &state) {
+    const int res = int(state.range(0));
+    const int quality = int(state.range(1));
+    const Inputs &in = inputs(res);
+    QByteArray out;
+    for (auto _ : state) {
+        out.clear();
+        QBuffer buffer(&out);
+        buffer.open(QIODevice::WriteOnly);
+        benchmark::DoNotOptimize(in.rgb.save(&buffer, "JPG", quality));
+    }
+    setPixelCounters(state, res);
+    state.counters["bytes"] = double(out.size());
+}
+
+void BM_DrawStatusAndRescale(benchmark::State &state) {
+    // Pierwotny drawStatusOnImage: pasek na pełnej klatce + SmoothTransformation do etykiety
+    const int res = int(state.range(0));
+    const Inputs &in = inputs(res);
+    for (auto _ : state) {
+        QImage work = in.rgb.copy();
+        StatusOverlay::paint(&work, StatusOverlay::Sent);
+        QImage scaled = work.scaled(kLabelSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        benchmark::DoNotOptimize(scaled.constBits());
+    }
+    setPixelCounters(state, res);
+}
+
+// ---------------------------------------------------------
+// Kernele OpenCV (ścieżka potoku przechwytywania)
+// ---------------------------------------------------------
+void BM_CvCvtColorBgr2Rgb(benchmark::State &state) {
+    const int res = int(state.range(0));
+    const Inputs &in = inputs(res);
+    cv::Mat rgb;
+    for (auto _ : state) {
+        cv::cvtColor(in.bgr, rgb, cv::COLOR_BGR2RGB);
+        benchmark::DoNotOptimize(rgb.data);
+    }
+    setPixelCounters(state, res);
+}
+
+void BM_CvImdecode(benchmark::State &state) {
+    const int res = int(state.range(0));
+    const Inputs &in = inputs(res);
+    const cv::Mat raw(1, int(in.jpeg.size()), CV_8UC1, const_cast<char*>(in.jpeg.constData()));
+    cv::Mat frame; // Bufor wielokrotnego użytku, jak w FramePool
+    for (auto _ : state) {
+        cv::imdecode(raw, cv::IMREAD_COLOR, &frame);
+        benchmark::DoNotOptimize(frame.data);
+    }
+    setPixelCounters(state, res);
+}
+
+void BM_CvRotate(benchmark::State &state) {
+    const int res = int(state.range(0));
+    const int angle = int(state.range(1));
+    const Inputs &in = inputs(res);
+    const int code = angle == 90 ? cv::ROTATE_90_CLOCKWISE
+                   : angle == 180 ? cv::ROTATE_180 : cv::ROTATE_90_COUNTERCLOCKWISE;
+    cv::Mat out;
+    for (auto _ : state) {
+        cv::rotate(in.bgr, out, code);
+        benchmark::DoNotOptimize(out.data);
+    }
+    setPixelCounters(state, res);
+}
+
+void BM_CvImencodeJpeg(benchmark::State &state) {
+    const int res = int(state.range(0));
+    const int quality = int(state.range(1));
+    const Inputs &in = inputs(res);
+    std::vector<uchar> buf;
+    for (auto _ : state) {
+        cv::imencode(".jpg", in.bgr, buf, { cv::IMWRITE_JPEG_QUALITY, quality });
+        benchmark::DoNotOptimize(buf.data());
+    }
+    setPixelCounters(state, res);
+    state.counters["bytes"] = double(buf.size());
+}
+
+void ResolutionArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({ "res" });
+    for (int res = 0; res < 3; ++res) b->Args({ res });
+}
+
+void RotationArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({ "res", "angle" });
+    for (int res = 0; res < 3; ++res)
+        for (int angle : { 90, 180, 270 }) b->Args({ res, angle });
+}
+
+void QualityArgs(benchmark::internal::Benchmark *b) {
+    b->ArgNames({ "res", "q" });
+    for (int res = 0; res < 3; ++res)
+        for (int q : { 85, 90 }) b->Args({ res, q });
+}
+
+}
+
+BENCHMARK(BM_QImageLoadFromData)->Apply(ResolutionArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QImageTransformed)->Apply(RotationArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_QImageSaveJpeg)->Apply(QualityArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DrawStatusAndRescale)->Apply(ResolutionArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CvCvtColorBgr2Rgb)->Apply(ResolutionArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CvImdecode)->Apply(ResolutionArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CvRotate)->Apply(RotationArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CvImencodeJpeg)->Apply(QualityArgs)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    // QPainter z tekstem potrzebuje QGuiApplication (fonty) - bez okna
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -1,9 +1,14 @@
 #include <QApplication>
-#include <QFontDatabase>
 #include <QDateTime>
 #include <QThread>
+#include <QCommandLineParser>
 #include <cstdio>
+#include <memory>
 #include "MainWindow.h"
+#include "StartupProfiler.h"
+#include "ScanTrace.h"
+#include "StallWatchdog.h"
+#include "ImageEncoder.h"
 
 // Funkcja formatująca logi w konsoli
 void customMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg) {
@@ -45,25 +50,58 @@ void customMessageHandler(QtMsgType type, const QMessageLogContext &context, con
 }
 
 int main(int argc, char *argv[]) {
+    StartupProfiler::start();
+
     // Instalacja handlera logów przed startem aplikacji
     qInstallMessageHandler(customMessageHandler);
 
     QApplication a(argc, argv);
+    StartupProfiler::mark("QApplication");
 
     qDebug() << ">>> SYSTEM STARTUP <<<";
-    qDebug() << "Loading fonts...";
+    // Czcionki Roboto rejestruje MainWindow::finishStartup - już po pokazaniu okna
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption recordOpt("record", "Nagrywaj skany i odpowiedzi kamer do pliku śladu.", "file");
+    QCommandLineOption replayOpt("replay", "Odtwórz plik śladu zamiast skanera i kamer.", "file");
+    QCommandLineOption speedOpt("replay-speed", "Tempo odtwarzania: 1, 10 lub max.", "speed", "1");
+    QCommandLineOption stallOpt("stall-threshold", "Próg zawieszenia pętli GUI w ms (0 = wyłączony).", "ms", "200");
+    QCommandLineOption encoderBenchOpt("encoder-bench", "Porównaj kodery zdjęć (bajty / czas / PSNR) na pliku lub katalogu i zakończ.", "path");
+    parser.addOptions({ recordOpt, replayOpt, speedOpt, stallOpt, encoderBenchOpt });
+    parser.process(a);
 
-    if(QFontDatabase::addApplicationFont(":/fonts/Roboto-Regular.ttf") == -1)
-        qWarning() << "Failed to load Roboto-Regular.ttf";
-    if(QFontDatabase::addApplicationFont(":/fonts/RobotoCondensed-Bold.ttf") == -1)
-        qWarning() << "Failed to load RobotoCondensed-Bold.ttf";
+    if (parser.isSet(encoderBenchOpt)) return ImageEncoder::runBenchmark(parser.value(encoderBenchOpt));
+
+    // Tempo sprawdzane przed startem okna - literówka nie może dać cichego odtwarzania "max"
+    double replaySpeed = 0.0;
+    if (parser.isSet(replayOpt) && parser.value(speedOpt) != "max") {
+        bool ok = false;
+        replaySpeed = parser.value(speedOpt).toDouble(&ok);
+        if (!ok || replaySpeed <= 0.0) {
+            fprintf(stderr, "replay: niepoprawne tempo '%s' (liczba > 0 lub max)\n", qPrintable(parser.value(speedOpt)));
+            return 1;
+        }
+    }
 
-    QFont font("Roboto", 10);
-    a.setFont(font);
+    if (parser.isSet(recordOpt)) ScanTraceRecorder::instance().open(parser.value(recordOpt));
 
     qDebug() << "Initializing MainWindow...";
     MainWindow w;
 
+    if (parser.isSet(replayOpt) && !w.startReplay(parser.value(replayOpt), replaySpeed)) {
+        fprintf(stderr, "replay: nie można odtworzyć śladu %s\n", qPrintable(parser.value(replayOpt)));
+        return 1;
+    }
+
+    // Watchdog startuje przed pętlą zdarzeń - zawieszenia od pierwszego skanu
+    std::unique_ptr<StallWatchdog> watchdog;
+    const int stallThresholdMs = parser.value(stallOpt).toInt();
+    if (stallThresholdMs > 0) {
+        watchdog.reset(new StallWatchdog(stallThresholdMs));
+        watchdog->start();
+    }
+
     qDebug() << "Entering Event Loop...";
     return a.exec();
 }